@@ -5,6 +5,8 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <utility>
 
 #include "binary.hpp"
 #include "serde.hpp"
@@ -15,21 +17,44 @@ namespace serde {
 constexpr size_t BCS_MAX_LENGTH = (1ull << 31) - 1;
 constexpr size_t BCS_MAX_CONTAINER_DEPTH = 500;
 
-class BcsSerializer : public BinarySerializer<BcsSerializer> {
-    using Parent = BinarySerializer<BcsSerializer>;
+template <class Output = VectorOutput>
+class BasicBcsSerializer
+    : public BinarySerializer<BasicBcsSerializer<Output>, Output> {
+    using Parent = BinarySerializer<BasicBcsSerializer<Output>, Output>;
+
+    static_assert(Output::retains_bytes ||
+                      std::is_same<Output, SizeCounter>::value,
+                  "BCS needs to reorder map entries in the output");
 
     void serialize_u32_as_uleb128(uint32_t);
 
+    // Scratch space for sorting map entries, kept across maps.
+    std::vector<std::pair<size_t, size_t>> entries_;
+    std::vector<uint8_t> scratch_;
+
   public:
-    BcsSerializer() : Parent(BCS_MAX_CONTAINER_DEPTH) {}
+    template <class O>
+    using with_output = BasicBcsSerializer<O>;
+
+    explicit BasicBcsSerializer(Output output = Output())
+        : Parent(BCS_MAX_CONTAINER_DEPTH, std::move(output)) {}
 
     void serialize_len(size_t value);
     void serialize_variant_index(uint32_t value);
 
-    static constexpr bool enforce_strict_map_ordering = true;
-    void sort_last_entries(std::vector<size_t> offsets);
+    // Map entries are only sorted when the output keeps the encoded bytes.
+    // The output holds the entries from `begin_map_entries` until they are
+    // sorted: even a `SinkOutput` keeps the whole outermost map in memory.
+    static constexpr bool enforce_strict_map_ordering = Output::retains_bytes;
+    void begin_map_entries() { this->output_.hold(); }
+    void sort_last_entries(const std::vector<size_t> &offsets);
+
+  private:
+    void sort_entries(const std::vector<size_t> &offsets);
 };
 
+using BcsSerializer = BasicBcsSerializer<>;
+
 class BcsDeserializer : public BinaryDeserializer<BcsDeserializer> {
     using Parent = BinaryDeserializer<BcsDeserializer>;
 
@@ -39,6 +64,12 @@ class BcsDeserializer : public BinaryDeserializer<BcsDeserializer> {
     BcsDeserializer(std::vector<uint8_t> bytes)
         : Parent(std::move(bytes), BCS_MAX_CONTAINER_DEPTH) {}
 
+    BcsDeserializer(const uint8_t *bytes, size_t size)
+        : Parent(bytes, size, BCS_MAX_CONTAINER_DEPTH) {}
+
+    explicit BcsDeserializer(Source source)
+        : Parent(std::move(source), BCS_MAX_CONTAINER_DEPTH) {}
+
     size_t deserialize_len();
     uint32_t deserialize_variant_index();
 
@@ -47,76 +78,187 @@ class BcsDeserializer : public BinaryDeserializer<BcsDeserializer> {
                                               std::tuple<size_t, size_t> key2);
 };
 
-inline void BcsSerializer::serialize_u32_as_uleb128(uint32_t value) {
+// Number of trailing zero bits of a non-zero integer.
+inline size_t count_trailing_zeros(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return (size_t)__builtin_ctzll(value);
+#else
+    size_t count = 0;
+    while ((value & 1) == 0) {
+        value >>= 1;
+        count++;
+    }
+    return count;
+#endif
+}
+
+// Lengths and variant indices are mostly single bytes. Longer values are
+// written with one call to the output.
+template <class Output>
+void BasicBcsSerializer<Output>::serialize_u32_as_uleb128(uint32_t value) {
+    if (value < 0x80) {
+        this->output_.write_byte((uint8_t)value);
+        this->count_bytes_written(1);
+        return;
+    }
+    uint8_t bytes[5];
+    size_t len = 0;
     while (value >= 0x80) {
-        bytes_.push_back((uint8_t)((value & 0x7F) | 0x80));
+        bytes[len++] = (uint8_t)((value & 0x7F) | 0x80);
         value = value >> 7;
     }
-    bytes_.push_back((uint8_t)value);
+    bytes[len++] = (uint8_t)value;
+    this->output_.write(bytes, len);
+    this->count_bytes_written(len);
 }
 
-inline void BcsSerializer::serialize_len(size_t value) {
+template <class Output>
+void BasicBcsSerializer<Output>::serialize_len(size_t value) {
     if (value > BCS_MAX_LENGTH) {
-        throw serde::serialization_error("Length is too large");
+        SERDE_THROW(serde::serialization_error("Length is too large"));
     }
     serialize_u32_as_uleb128((uint32_t)value);
 }
 
-inline void BcsSerializer::serialize_variant_index(uint32_t value) {
+template <class Output>
+void BasicBcsSerializer<Output>::serialize_variant_index(uint32_t value) {
     serialize_u32_as_uleb128(value);
 }
 
-inline void BcsSerializer::sort_last_entries(std::vector<size_t> offsets) {
-    if (offsets.size() <= 1) {
-        return;
+// Whether the bytes [start1, end1) are lexicographically smaller than the
+// bytes [start2, end2).
+inline bool is_smaller_slice(const uint8_t *start1, const uint8_t *end1,
+                             const uint8_t *start2, const uint8_t *end2) {
+    return std::lexicographical_compare(start1, end1, start2, end2);
+}
+
+// Sort the map entries starting at the given offsets and ending at the end of
+// the output, then release them.
+template <class Output>
+void BasicBcsSerializer<Output>::sort_last_entries(
+    const std::vector<size_t> &offsets) {
+    if (offsets.size() > 1) {
+        SERDE_COUNT(map_entries_sorted, offsets.size());
+        sort_entries(offsets);
     }
-    offsets.push_back(bytes_.size());
+    this->output_.release();
+}
+
+// Entries are compared as byte slices in place; they are only moved, through
+// a single scratch copy, when they are out of order. Positions are relative to
+// the first entry.
+template <class Output>
+void BasicBcsSerializer<Output>::sort_entries(
+    const std::vector<size_t> &offsets) {
+    auto &output = this->output_;
+    auto start = offsets[0];
+    auto end = output.size() - start;
+    uint8_t *data = output.data_at(start);
+    auto entry_start = [&](size_t i) { return offsets[i] - start; };
+    auto entry_end = [&](size_t i) {
+        return i + 1 < offsets.size() ? entry_start(i + 1) : end;
+    };
 
-    std::vector<std::vector<uint8_t>> slices;
-    for (auto i = 1; i < offsets.size(); i++) {
-        auto start = bytes_.cbegin() + offsets[i - 1];
-        auto end = bytes_.cbegin() + offsets[i];
-        slices.emplace_back(start, end);
+    // Maps are usually iterated in the order of their encoded keys.
+    bool sorted = true;
+    for (size_t i = 1; i < offsets.size(); i++) {
+        if (is_smaller_slice(data + entry_start(i), data + entry_end(i),
+                             data + entry_start(i - 1),
+                             data + entry_start(i))) {
+            sorted = false;
+            break;
+        }
+    }
+    if (sorted) {
+        return;
     }
 
-    std::sort(slices.begin(), slices.end(), [](auto &s1, auto &s2) {
-        return std::lexicographical_compare(s1.begin(), s1.end(), s2.begin(),
-                                            s2.end());
-    });
+    entries_.clear();
+    for (size_t i = 0; i < offsets.size(); i++) {
+        entries_.emplace_back(entry_start(i), entry_end(i));
+    }
+    std::sort(entries_.begin(), entries_.end(),
+              [data](const auto &e1, const auto &e2) {
+                  return is_smaller_slice(data + e1.first, data + e1.second,
+                                          data + e2.first, data + e2.second);
+              });
 
-    bytes_.resize(offsets[0]);
-    for (auto slice : slices) {
-        bytes_.insert(bytes_.end(), slice.begin(), slice.end());
+    scratch_.assign(data, data + end);
+    auto pos = data;
+    for (const auto &entry : entries_) {
+        auto len = entry.second - entry.first;
+        memcpy(pos, scratch_.data() + entry.first, len);
+        pos += len;
     }
-    assert(offsets.back() == bytes_.size());
+    assert(pos == data + end);
 }
 
+// Lengths and variant indices are mostly single bytes, decoded with one
+// branch. When the 5 bytes of the longest encoding are in memory, longer
+// values are decoded from a word: the first byte with a clear high bit ends the
+// encoding, then the 7-bit digits are gathered with shifts. Otherwise bytes are
+// read one at a time. Either way, errors are reported at the start of the
+// encoding.
 inline uint32_t BcsDeserializer::deserialize_uleb128_as_u32() {
+    size_t available = available_bytes();
+    if (available > 0 && next_bytes()[0] < 0x80) {
+        uint8_t byte = next_bytes()[0];
+        advance(1);
+        return byte;
+    }
+    if (available >= 5) {
+        uint8_t buffer[8] = {};
+        std::memcpy(buffer, next_bytes(), 5);
+        uint64_t word = load_le<uint64_t>(buffer);
+        uint64_t ends = ~word & 0x8080808080ull;
+        if (ends == 0) {
+            fail(deserialization_errc::uleb128_overflow);
+            return 0;
+        }
+        size_t len = count_trailing_zeros(ends) / 8 + 1;
+        word &= ~0ull >> (64 - 8 * len);
+        uint64_t value = (word & 0x7F) | ((word >> 1) & 0x3F80) |
+                         ((word >> 2) & 0x1FC000) | ((word >> 3) & 0xFE00000) |
+                         ((word >> 4) & 0x7F0000000);
+        if (value > std::numeric_limits<uint32_t>::max()) {
+            fail(deserialization_errc::uleb128_overflow);
+            return 0;
+        }
+        // The last digit of a canonical encoding is not zero.
+        if ((word >> (8 * (len - 1))) == 0) {
+            fail(deserialization_errc::invalid_uleb128);
+            return 0;
+        }
+        advance(len);
+        return (uint32_t)value;
+    }
+    size_t start = get_buffer_offset();
     uint64_t value = 0;
     for (int shift = 0; shift < 32; shift += 7) {
         auto byte = read_byte();
         auto digit = byte & 0x7F;
         value |= (uint64_t)digit << shift;
         if (value > std::numeric_limits<uint32_t>::max()) {
-            throw serde::deserialization_error(
-                "Overflow while parsing uleb128-encoded uint32 value");
+            fail_at(deserialization_errc::uleb128_overflow, start);
+            return 0;
         }
         if (digit == byte) {
             if (shift > 0 && digit == 0) {
-                throw serde::deserialization_error(
-                    "Invalid uleb128 number (unexpected zero digit)");
+                fail_at(deserialization_errc::invalid_uleb128, start);
+                return 0;
             }
             return (uint32_t)value;
         }
     }
-    throw serde::deserialization_error(
-        "Overflow while parsing uleb128-encoded uint32 value");
+    fail_at(deserialization_errc::uleb128_overflow, start);
+    return 0;
 }
 
 inline size_t BcsDeserializer::deserialize_len() {
     auto value = deserialize_uleb128_as_u32();
     if (value > BCS_MAX_LENGTH) {
-        throw serde::deserialization_error("Length is too large");
+        fail(deserialization_errc::length_too_large);
+        return 0;
     }
     return (size_t)value;
 }
@@ -127,13 +269,11 @@ inline uint32_t BcsDeserializer::deserialize_variant_index() {
 
 inline void BcsDeserializer::check_that_key_slices_are_increasing(
     std::tuple<size_t, size_t> key1, std::tuple<size_t, size_t> key2) {
-    if (!std::lexicographical_compare(bytes_.cbegin() + std::get<0>(key1),
-                                      bytes_.cbegin() + std::get<1>(key1),
-                                      bytes_.cbegin() + std::get<0>(key2),
-                                      bytes_.cbegin() + std::get<1>(key2))) {
-        throw serde::deserialization_error(
-            "Error while decoding map: keys are not serialized in the "
-            "expected order");
+    SERDE_COUNT(map_keys_checked, 1);
+    if (!is_smaller_slice(
+            data_at(std::get<0>(key1)), data_at(std::get<1>(key1)),
+            data_at(std::get<0>(key2)), data_at(std::get<1>(key2)))) {
+        fail(deserialization_errc::unsorted_map_keys);
     }
 }
 
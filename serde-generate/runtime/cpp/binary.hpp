@@ -4,24 +4,495 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cstring>
+#include <functional>
+#include <exception>
+#include <istream>
+#include <ostream>
+#include <queue>
+#include <system_error>
+#include <thread>
 #include <variant>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #include "serde.hpp"
 
 namespace serde {
 
-template <class S>
+// Binary formats encode integers in little-endian order. On little-endian
+// hosts, integers are loaded and stored with a single (unaligned) memcpy.
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) &&                \
+    __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+constexpr bool host_is_little_endian = false;
+#else
+constexpr bool host_is_little_endian = true;
+#endif
+
+template <typename T>
+inline T byte_swap(T value) {
+    static_assert(std::is_unsigned<T>::value, "expecting an unsigned integer");
+    T result = 0;
+    for (size_t i = 0; i < sizeof(T); i++) {
+        result = (T)((result << 8) | (uint8_t)(value >> (8 * i)));
+    }
+    return result;
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+template <>
+inline uint16_t byte_swap(uint16_t value) {
+    return __builtin_bswap16(value);
+}
+
+template <>
+inline uint32_t byte_swap(uint32_t value) {
+    return __builtin_bswap32(value);
+}
+
+template <>
+inline uint64_t byte_swap(uint64_t value) {
+    return __builtin_bswap64(value);
+}
+#endif
+
+// Read a little-endian unsigned integer from (possibly unaligned) memory.
+template <typename T>
+inline T load_le(const uint8_t *bytes) {
+    T value;
+    std::memcpy(&value, bytes, sizeof(T));
+    if constexpr (!host_is_little_endian) {
+        value = byte_swap(value);
+    }
+    return value;
+}
+
+// Write a little-endian unsigned integer to (possibly unaligned) memory.
+template <typename T>
+inline void store_le(uint8_t *bytes, T value) {
+    if constexpr (!host_is_little_endian) {
+        value = byte_swap(value);
+    }
+    std::memcpy(bytes, &value, sizeof(T));
+}
+
+// Read and write big-endian unsigned integers, for formats that support this
+// byte order (e.g. some configurations of Bincode).
+template <typename T>
+inline T load_be(const uint8_t *bytes) {
+    T value;
+    std::memcpy(&value, bytes, sizeof(T));
+    if constexpr (host_is_little_endian) {
+        value = byte_swap(value);
+    }
+    return value;
+}
+
+template <typename T>
+inline void store_be(uint8_t *bytes, T value) {
+    if constexpr (host_is_little_endian) {
+        value = byte_swap(value);
+    }
+    std::memcpy(bytes, &value, sizeof(T));
+}
+
+// Whether the binary encoding of T is its in-memory representation, so that
+// values, arrays and sequences of T can be (de)serialized with a single memcpy.
+// Only single bytes have the same representation on big-endian hosts.
+template <typename T>
+constexpr bool is_memcpy_encodable =
+    MemcpyLayout<T>::value &&
+    (host_is_little_endian || std::is_same<T, uint8_t>::value ||
+     std::is_same<T, int8_t>::value);
+
+// Outputs of binary serializers. An output receives the encoded bytes and
+// tracks how many were written. Outputs that `retain_bytes` also give access
+// to the bytes written since the outermost `hold()` with `data_at(offset)`,
+// which BCS needs to sort map entries in place before `release()`.
+// `reset()` discards the bytes written so far but keeps any allocated memory.
+
+// Growable buffer owned by the serializer.
+class VectorOutput {
+    std::vector<uint8_t> bytes_;
+
+  public:
+    static constexpr bool retains_bytes = true;
+
+    void write_byte(uint8_t byte) { bytes_.push_back(byte); }
+    void write(const uint8_t *bytes, size_t len) {
+        bytes_.insert(bytes_.end(), bytes, bytes + len);
+    }
+    size_t size() const { return bytes_.size(); }
+    void reserve(size_t size) { bytes_.reserve(size); }
+    void reset() { bytes_.clear(); }
+
+    void hold() {}
+    void release() {}
+    uint8_t *data_at(size_t offset) { return bytes_.data() + offset; }
+    uint8_t *data() { return bytes_.data(); }
+
+    const std::vector<uint8_t> &bytes() const & { return bytes_; }
+    std::vector<uint8_t> bytes() && { return std::move(bytes_); }
+};
+
+// Appends to a vector owned by the caller. Bytes already present in the vector
+// are left untouched and are not counted as output.
+class VectorRefOutput {
+    std::vector<uint8_t> *bytes_;
+    size_t start_;
+
+  public:
+    static constexpr bool retains_bytes = true;
+
+    VectorRefOutput(std::vector<uint8_t> &bytes)
+        : bytes_(&bytes), start_(bytes.size()) {}
+
+    void write_byte(uint8_t byte) { bytes_->push_back(byte); }
+    void write(const uint8_t *bytes, size_t len) {
+        bytes_->insert(bytes_->end(), bytes, bytes + len);
+    }
+    size_t size() const { return bytes_->size() - start_; }
+    void reserve(size_t size) { bytes_->reserve(start_ + size); }
+    void reset() { bytes_->resize(start_); }
+
+    void hold() {}
+    void release() {}
+    uint8_t *data_at(size_t offset) { return bytes_->data() + start_ + offset; }
+    uint8_t *data() { return bytes_->data() + start_; }
+};
+
+// Fixed-size buffer owned by the caller. Running out of space is a
+// serialization error.
+class BufferOutput {
+    uint8_t *buffer_;
+    size_t capacity_;
+    size_t size_ = 0;
+
+  public:
+    static constexpr bool retains_bytes = true;
+
+    BufferOutput(uint8_t *buffer, size_t capacity)
+        : buffer_(buffer), capacity_(capacity) {}
+
+    void write_byte(uint8_t byte) {
+        if (size_ == capacity_) {
+            SERDE_THROW(serialization_error("Output buffer is too small"));
+        }
+        buffer_[size_++] = byte;
+    }
+    void write(const uint8_t *bytes, size_t len) {
+        if (len > capacity_ - size_) {
+            SERDE_THROW(serialization_error("Output buffer is too small"));
+        }
+        if (len > 0) {
+            memcpy(buffer_ + size_, bytes, len);
+            size_ += len;
+        }
+    }
+    size_t size() const { return size_; }
+    void reserve(size_t) {}
+    void reset() { size_ = 0; }
+
+    void hold() {}
+    void release() {}
+    uint8_t *data_at(size_t offset) { return buffer_ + offset; }
+    uint8_t *data() { return buffer_; }
+};
+
+// Writes to a sink through a bounded buffer, so that large values are
+// serialized with constant memory. `Sink` provides a method
+// `write(const uint8_t *, size_t)`. The buffer is passed to the sink when it
+// is full, except while bytes are held: the entries of the outermost BCS map
+// being written stay in memory until the map is sorted, however large the map
+// is. The buffer then grows up to `max_capacity` bytes, past which a map
+// cannot be encoded and a serialization error is raised. Call `flush()` once
+// serialization is complete.
+template <typename Sink>
+class SinkOutput {
+    Sink sink_;
+    std::vector<uint8_t> buffer_;
+    size_t capacity_;
+    size_t max_capacity_;
+    // Number of bytes already passed to the sink.
+    size_t flushed_ = 0;
+    size_t holds_ = 0;
+
+    // Called when the buffer is full.
+    void check_held(size_t len) {
+        if (len > max_capacity_ - buffer_.size()) {
+            SERDE_THROW(serialization_error(
+                "Map entries exceed the maximal capacity of the output"));
+        }
+    }
+
+  public:
+    static constexpr bool retains_bytes = true;
+    static constexpr size_t default_capacity = 1 << 16;
+
+    explicit SinkOutput(Sink sink, size_t capacity = default_capacity,
+                        size_t max_capacity = SIZE_MAX)
+        : sink_(std::move(sink)), capacity_(capacity),
+          max_capacity_(std::max(capacity, max_capacity)) {
+        buffer_.reserve(capacity);
+    }
+
+    void write_byte(uint8_t byte) {
+        if (buffer_.size() >= capacity_) {
+            if (holds_ == 0) {
+                flush();
+            } else {
+                check_held(1);
+            }
+        }
+        buffer_.push_back(byte);
+    }
+    void write(const uint8_t *bytes, size_t len) {
+        if (buffer_.size() + len > capacity_) {
+            if (holds_ > 0) {
+                check_held(len);
+            } else {
+                flush();
+                // Large writes bypass the buffer.
+                if (len >= capacity_) {
+                    sink_.write(bytes, len);
+                    flushed_ += len;
+                    return;
+                }
+            }
+        }
+        buffer_.insert(buffer_.end(), bytes, bytes + len);
+    }
+    size_t size() const { return flushed_ + buffer_.size(); }
+    void reserve(size_t) {}
+    // Bytes already passed to the sink cannot be taken back.
+    void reset() {
+        buffer_.clear();
+        flushed_ = 0;
+        holds_ = 0;
+    }
+
+    void hold() { holds_++; }
+    void release() { holds_--; }
+    uint8_t *data_at(size_t offset) {
+        assert(offset >= flushed_);
+        return buffer_.data() + (offset - flushed_);
+    }
+
+    // Pass the buffered bytes to the sink.
+    void flush() {
+        assert(holds_ == 0);
+        if (!buffer_.empty()) {
+            sink_.write(buffer_.data(), buffer_.size());
+            flushed_ += buffer_.size();
+            buffer_.clear();
+        }
+    }
+
+    Sink &sink() { return sink_; }
+};
+
+// Sink writing to a std::ostream owned by the caller.
+class OstreamSink {
+    std::ostream *stream_;
+
+  public:
+    explicit OstreamSink(std::ostream &stream) : stream_(&stream) {}
+
+    void write(const uint8_t *bytes, size_t len) {
+        stream_->write(reinterpret_cast<const char *>(bytes), len);
+        if (!*stream_) {
+            SERDE_THROW(serialization_error("Failed to write to stream"));
+        }
+    }
+};
+
+#if defined(__unix__) || defined(__APPLE__)
+// Sink writing to a file descriptor owned by the caller.
+class FdSink {
+    int fd_;
+
+  public:
+    explicit FdSink(int fd) : fd_(fd) {}
+
+    void write(const uint8_t *bytes, size_t len) {
+        while (len > 0) {
+            auto written = ::write(fd_, bytes, len);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                SERDE_THROW(
+                    serialization_error("Failed to write to file descriptor"));
+            }
+            bytes += written;
+            len -= (size_t)written;
+        }
+    }
+};
+#endif
+
+// Writes through an output iterator. Written bytes cannot be revisited, so
+// this output is not available for BCS.
+template <typename OutputIt>
+class IteratorOutput {
+    OutputIt it_;
+    size_t size_ = 0;
+
+  public:
+    static constexpr bool retains_bytes = false;
+
+    IteratorOutput(OutputIt it) : it_(std::move(it)) {}
+
+    void write_byte(uint8_t byte) {
+        *it_ = byte;
+        ++it_;
+        size_++;
+    }
+    void write(const uint8_t *bytes, size_t len) {
+        it_ = std::copy(bytes, bytes + len, it_);
+        size_ += len;
+    }
+    size_t size() const { return size_; }
+    void reserve(size_t) {}
+    void reset() { size_ = 0; }
+
+    const OutputIt &iterator() const { return it_; }
+};
+
+// Output that only counts bytes. Used to compute the exact size of encodings.
+class SizeCounter {
+    size_t size_ = 0;
+
+  public:
+    static constexpr bool retains_bytes = false;
+
+    void write_byte(uint8_t) { size_++; }
+    void write(const uint8_t *, size_t len) { size_ += len; }
+    size_t size() const { return size_; }
+    void reserve(size_t) {}
+    void reset() { size_ = 0; }
+};
+
+// Callback running `count` tasks, numbered from 0, possibly in parallel. It
+// returns once all tasks are complete.
+using Executor =
+    std::function<void(size_t count, const std::function<void(size_t)> &task)>;
+
+// Executor running tasks on `threads` threads, including the calling one.
+// Threads take the next task from a shared counter, so that uneven tasks
+// balance out. If a task throws, the remaining tasks are skipped and the
+// first exception is rethrown once all threads are joined.
+inline Executor
+thread_executor(size_t threads = std::thread::hardware_concurrency()) {
+    return [threads](size_t count, const std::function<void(size_t)> &task) {
+        size_t spawned = std::max<size_t>(std::min(threads, count), 1) - 1;
+        std::atomic<size_t> next{0};
+#if SERDE_EXCEPTIONS
+        std::vector<std::exception_ptr> errors(spawned + 1);
+#endif
+        auto work = [&](size_t t) {
+#if SERDE_EXCEPTIONS
+            try {
+#endif
+                for (size_t i; (i = next.fetch_add(1)) < count;) {
+                    task(i);
+                }
+#if SERDE_EXCEPTIONS
+            } catch (...) {
+                errors[t] = std::current_exception();
+                next = count;
+            }
+#else
+            (void)t;
+#endif
+        };
+        std::vector<std::thread> workers;
+        workers.reserve(spawned);
+#if SERDE_EXCEPTIONS
+        // Threads that cannot be started leave their share to the others.
+        try {
+#endif
+            for (size_t t = 1; t <= spawned; t++) {
+                workers.emplace_back(work, t);
+            }
+#if SERDE_EXCEPTIONS
+        } catch (const std::system_error &) {
+        }
+#endif
+        work(0);
+        for (auto &worker : workers) {
+            worker.join();
+        }
+#if SERDE_EXCEPTIONS
+        for (const auto &error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+#endif
+    };
+}
+
+// Encodings of a sequence of values, concatenated in a single buffer. The
+// i-th value is encoded in the bytes [offsets[i], offsets[i + 1]).
+struct EncodedBatch {
+    std::vector<uint8_t> bytes;
+    std::vector<size_t> offsets;
+};
+
+template <class S, class Output>
 class BinarySerializer {
+    // Serializers with other outputs encode parts of parallel sequences.
+    template <class, class>
+    friend class BinarySerializer;
+
+    // Parallel encoding of sequences (disabled by default).
+    Executor executor_;
+    size_t parallel_max_depth_ = 0;
+    size_t parallel_min_len_ = SIZE_MAX;
+
+    // Encode the `len` items starting at `begin` by groups, concurrently, then
+    // append the groups to the output. With `sort_items`, the encodings of the
+    // items are written in lexicographic order instead: groups are sorted
+    // concurrently, then merged.
+    template <typename Iterator, typename Encode>
+    void serialize_in_parallel(Iterator begin, size_t len, bool sort_items,
+                               Encode encode);
+
   protected:
-    std::vector<uint8_t> bytes_;
+    Output output_;
+    size_t max_container_depth_;
     size_t container_depth_budget_;
 
+    template <typename T>
+    void write_le(T value);
+
+    // Account for bytes appended to the output. Counting passes (see
+    // `serialized_size`) are not included.
+    void count_bytes_written(size_t len) {
+        if constexpr (!std::is_same<Output, SizeCounter>::value) {
+            SERDE_COUNT(bytes_written, len);
+        }
+        (void)len;
+    }
+
   public:
-    BinarySerializer(size_t max_container_depth)
-        : container_depth_budget_(max_container_depth) {}
+    BinarySerializer(size_t max_container_depth, Output output = Output())
+        : output_(std::move(output)), max_container_depth_(max_container_depth),
+          container_depth_budget_(max_container_depth) {}
 
-    void serialize_str(const std::string &value);
+    void serialize_str(std::string_view value);
 
     void serialize_bool(bool value);
     void serialize_unit();
@@ -42,28 +513,196 @@ class BinarySerializer {
     void serialize_i128(const int128_t &value);
     void serialize_option_tag(bool value);
 
+    // Sequences and arrays of these types are written in bulk with
+    // `serialize_raw_bytes`.
+    template <typename T>
+    static constexpr bool is_bulk_copyable = is_memcpy_encodable<T>;
+    // Whether integers are encoded with their fixed width, so that types with
+    // an `EncodedSize` have encodings of that size, and in which byte order.
+    static constexpr bool fixed_width_integers = true;
+    static constexpr bool little_endian_integers = true;
+    // Append bytes to the output without a length prefix.
+    void serialize_raw_bytes(const uint8_t *bytes, size_t len);
+
     size_t get_buffer_offset();
     void increase_container_depth();
     void decrease_container_depth();
+    // Whether `depth` more containers can be nested without tracking them.
+    // Instrumented builds track every container to report the maximal depth.
+    bool fits_container_depth(size_t depth) const {
+        return !SERDE_INSTRUMENTATION && container_depth_budget_ >= depth;
+    }
+    // Whether generated code may skip the tracking of a type nesting at most
+    // `depth` containers. With a parallel executor, containers are always
+    // tracked, since `max_depth` is checked against the current depth.
+    bool has_container_depth_budget(size_t depth) const {
+        return !executor_ && fits_container_depth(depth);
+    }
 
-    std::vector<uint8_t> bytes() && { return std::move(bytes_); }
+    // Exact size of the encoding of `value`. This is a compile-time constant
+    // for types with a static encoded size, otherwise it is computed by a
+    // counting pass over `value`.
+    template <typename T>
+    static size_t serialized_size(const T &value);
+    void reserve(size_t size) { output_.reserve(size); }
+
+    // Encode `values` one after the other with a single serializer, so that
+    // the output buffer and scratch space are shared by all values.
+    template <typename T>
+    static EncodedBatch serialize_batch(const std::vector<T> &values);
+
+    // Prepare the serializer for a new value. Memory held by the output is
+    // kept, so that a long-lived serializer stops allocating once warm.
+    void reset();
+
+    // Opt in to encoding the elements of sequences and the entries of maps
+    // with `executor`, when there are at least `min_len` of them and they are
+    // nested in at most `max_depth` containers. Groups of elements are encoded
+    // concurrently into separate buffers, sized by a counting pass, then
+    // spliced into the output. For BCS, map entries are sorted concurrently
+    // by group, then merged.
+    void set_parallel_executor(Executor executor, size_t max_depth = 1,
+                               size_t min_len = 1024) {
+        executor_ = std::move(executor);
+        parallel_max_depth_ = max_depth;
+        parallel_min_len_ = min_len;
+    }
+    bool should_encode_in_parallel(size_t len) const {
+        return len >= parallel_min_len_ &&
+               max_container_depth_ - container_depth_budget_ <=
+                   parallel_max_depth_;
+    }
+    template <typename T, typename Allocator>
+    void serialize_elements_in_parallel(const std::vector<T, Allocator> &value);
+    template <typename Map>
+    void serialize_entries_in_parallel(const Map &value);
+
+    Output &output() { return output_; }
+    const std::vector<uint8_t> &bytes() const & { return output_.bytes(); }
+    std::vector<uint8_t> bytes() && { return std::move(output_).bytes(); }
 };
 
+// Callback filling the given buffer with up to `len` input bytes. Returns the
+// number of bytes read, or 0 at the end of the input.
+using Source = std::function<size_t(uint8_t *buffer, size_t len)>;
+
+// Source reading from a std::istream owned by the caller. Each call waits for
+// one byte only, then takes the bytes the stream has already buffered, so that
+// pipes and sockets are not read past the input that was asked for.
+inline Source istream_source(std::istream &stream) {
+    return [&stream](uint8_t *buffer, size_t len) -> size_t {
+        auto chars = reinterpret_cast<char *>(buffer);
+        if (len == 0 || !stream.read(chars, 1)) {
+            return 0;
+        }
+        return 1 + (size_t)stream.readsome(chars + 1, (std::streamsize)len - 1);
+    };
+}
+
 template <class D>
 class BinaryDeserializer {
     size_t pos_;
+    size_t max_container_depth_;
     size_t container_depth_budget_;
+    // Storage used when the deserializer owns its input. When reading from a
+    // source, only `size_` bytes of it are valid.
+    std::vector<uint8_t> owned_bytes_;
+    Source source_;
+    // Offset in the input of the first byte still in memory.
+    size_t base_ = 0;
+    // Number of open maps, and offset where the outermost one starts.
+    size_t holds_ = 0;
+    size_t hold_start_ = 0;
+    // First error recorded when errors are not thrown.
+    bool throw_on_error_ = true;
+    deserialization_errc error_ = deserialization_errc::ok;
+    size_t error_offset_ = 0;
+    // Parallel decoding of sequences (disabled by default).
+    Executor executor_;
+    size_t parallel_max_depth_ = 0;
+    size_t parallel_min_len_ = SIZE_MAX;
 
   protected:
-    std::vector<uint8_t> bytes_;
+    // Input bytes (owned or borrowed).
+    const uint8_t *bytes_;
+    size_t size_;
     uint8_t read_byte();
+    // Check once that `len` bytes are available, then consume them. Returns
+    // null after an error. The result is invalidated by further reads.
+    const uint8_t *read_bytes(size_t len);
+    template <typename T>
+    T read_le();
+    // Bytes already in memory, for fast paths that inspect the input before
+    // consuming it with `advance`. Nothing is available after an error.
+    size_t available_bytes() const { return size_ - pos_; }
+    const uint8_t *next_bytes() const { return bytes_ + pos_; }
+    void advance(size_t len) {
+        pos_ += len;
+        SERDE_COUNT(bytes_read, len);
+    }
+    // Pointer to the byte at the given offset of the input, which must still
+    // be in memory.
+    const uint8_t *data_at(size_t offset) { return bytes_ + (offset - base_); }
+
+  private:
+    // Pull bytes from the source until `len` bytes are available.
+    bool fill(size_t len);
+    static constexpr size_t source_chunk_size = 1 << 16;
 
   public:
+    // Deserialize from an owned buffer.
     BinaryDeserializer(std::vector<uint8_t> bytes, size_t max_container_depth)
-        : pos_(0), container_depth_budget_(max_container_depth),
-          bytes_(std::move(bytes)) {}
+        : pos_(0), max_container_depth_(max_container_depth),
+          container_depth_budget_(max_container_depth),
+          owned_bytes_(std::move(bytes)), bytes_(owned_bytes_.data()),
+          size_(owned_bytes_.size()) {}
+
+    // Deserialize from a borrowed buffer without copying it. The bytes must
+    // outlive the deserializer.
+    BinaryDeserializer(const uint8_t *bytes, size_t size,
+                       size_t max_container_depth)
+        : pos_(0), max_container_depth_(max_container_depth),
+          container_depth_budget_(max_container_depth), bytes_(bytes),
+          size_(size) {}
+
+    // Deserialize from bytes pulled from `source` on demand, so that decoding
+    // can start before the input is complete. Bytes are discarded once
+    // consumed, except for the entries of the outermost map being read when
+    // map keys are checked against each other.
+    BinaryDeserializer(Source source, size_t max_container_depth)
+        : pos_(0), max_container_depth_(max_container_depth),
+          container_depth_budget_(max_container_depth),
+          source_(std::move(source)), bytes_(nullptr), size_(0) {}
+
+    // Deserializers are cursors over their input: they can be moved but not
+    // copied.
+    BinaryDeserializer(const BinaryDeserializer &) = delete;
+    BinaryDeserializer &operator=(const BinaryDeserializer &) = delete;
+    BinaryDeserializer(BinaryDeserializer &&) = default;
+    BinaryDeserializer &operator=(BinaryDeserializer &&) = default;
+
+    // Errors are thrown as `deserialization_error` by default. Otherwise, the
+    // first error is recorded, the rest of the input is ignored and reads
+    // return zeros, so that decoding unwinds quickly. The partially decoded
+    // value must then be discarded.
+    void set_throw_on_error(bool value) { throw_on_error_ = value; }
+    void fail(deserialization_errc code);
+    // Same as `fail`, for an error found at an earlier offset of the input.
+    void fail_at(deserialization_errc code, size_t offset);
+    bool has_failed() const { return error_ != deserialization_errc::ok; }
+    deserialization_failure get_failure() const {
+        return {error_, error_offset_};
+    }
 
-    std::string deserialize_str();
+    template <typename Allocator = std::allocator<char>>
+    std::basic_string<char, std::char_traits<char>, Allocator>
+    deserialize_str(const Allocator &allocator = Allocator());
+    // Decode a string into `value`, reusing its capacity.
+    template <typename Allocator>
+    void deserialize_str_into(
+        std::basic_string<char, std::char_traits<char>, Allocator> &value);
+    // Consume a string without copying it.
+    void skip_str();
 
     bool deserialize_bool();
     std::monostate deserialize_unit();
@@ -85,180 +724,785 @@ class BinaryDeserializer {
 
     bool deserialize_option_tag();
 
+    // Decode a sequence of values from their concatenated encodings (see
+    // `EncodedBatch`) with a single deserializer. Each value must use exactly
+    // the bytes given by its offsets.
+    template <typename T>
+    static std::vector<T> deserialize_batch(const uint8_t *bytes, size_t size,
+                                            const std::vector<size_t> &offsets);
+    template <typename T>
+    static std::vector<T> deserialize_batch(const EncodedBatch &batch) {
+        return deserialize_batch<T>(batch.bytes.data(), batch.bytes.size(),
+                                    batch.offsets);
+    }
+
+    // Sequences and arrays of these types are read in bulk with
+    // `deserialize_raw_bytes`.
+    template <typename T>
+    static constexpr bool is_bulk_copyable = is_memcpy_encodable<T>;
+    // See `BinarySerializer::fixed_width_integers`.
+    static constexpr bool fixed_width_integers = true;
+    static constexpr bool little_endian_integers = true;
+    // Consume `len` bytes of input. The result points into the input buffer.
+    const uint8_t *deserialize_raw_bytes(size_t len);
+
     size_t get_buffer_offset();
+    // Number of input bytes left, or already pulled from the source. Used to
+    // bound allocations driven by untrusted lengths.
+    size_t get_remaining_bytes();
+    // Hand over the bytes pulled from the source past the current position,
+    // such as the start of the next message of a stream. Decoding then resumes
+    // from the source. Without a source, these are the remaining input bytes.
+    std::vector<uint8_t> take_buffered_bytes();
     void increase_container_depth();
     void decrease_container_depth();
+    // See `BinarySerializer::fits_container_depth`.
+    bool fits_container_depth(size_t depth) const {
+        return !SERDE_INSTRUMENTATION && container_depth_budget_ >= depth;
+    }
+    // See `BinarySerializer::has_container_depth_budget`.
+    bool has_container_depth_budget(size_t depth) const {
+        return !executor_ && fits_container_depth(depth);
+    }
+
+    // Keep the bytes of map entries in memory while their keys are checked.
+    void begin_map_entries() {
+        if (holds_++ == 0) {
+            hold_start_ = base_ + pos_;
+        }
+    }
+    void end_map_entries() { holds_--; }
+
+    // Opt in to decoding the elements of sequences with `executor`, for
+    // sequences of at least `min_len` elements nested in at most `max_depth`
+    // containers. Element boundaries are found first with `Skippable`, then
+    // groups of elements are decoded concurrently by separate deserializers.
+    // Memory resources must then be thread-safe. Not available when reading
+    // from a source.
+    void set_parallel_executor(Executor executor, size_t max_depth = 1,
+                               size_t min_len = 1024) {
+        executor_ = std::move(executor);
+        parallel_max_depth_ = max_depth;
+        parallel_min_len_ = min_len;
+    }
+    bool should_decode_in_parallel(size_t len) const {
+        return len >= parallel_min_len_ && !source_ &&
+               max_container_depth_ - container_depth_budget_ <=
+                   parallel_max_depth_;
+    }
+    template <typename T, typename Allocator>
+    void deserialize_elements_in_parallel(std::vector<T, Allocator> &result,
+                                          size_t len);
+
+#if defined(__cpp_lib_memory_resource)
+    // Memory resource used by polymorphic allocators of decoded values.
+    void set_memory_resource(std::pmr::memory_resource *resource) {
+        memory_resource_ = resource;
+    }
+    std::pmr::memory_resource *get_memory_resource() {
+        return memory_resource_;
+    }
+
+  private:
+    std::pmr::memory_resource *memory_resource_ =
+        std::pmr::get_default_resource();
+#endif
 };
 
-template <class S>
-void BinarySerializer<S>::serialize_str(const std::string &value) {
+template <class S, class Output>
+void BinarySerializer<S, Output>::serialize_str(std::string_view value) {
     static_cast<S *>(this)->serialize_len(value.size());
-    for (auto c : value) {
-        bytes_.push_back(c);
-    }
+    serialize_raw_bytes(reinterpret_cast<const uint8_t *>(value.data()),
+                        value.size());
 }
 
-template <class S>
-void BinarySerializer<S>::serialize_unit() {}
+template <class S, class Output>
+void BinarySerializer<S, Output>::serialize_unit() {}
 
-template <class S>
-void BinarySerializer<S>::serialize_f32(float) {
-    throw serde::serialization_error("not implemented");
+template <class S, class Output>
+void BinarySerializer<S, Output>::serialize_f32(float) {
+    SERDE_THROW(serde::serialization_error("not implemented"));
 }
 
-template <class S>
-void BinarySerializer<S>::serialize_f64(double) {
-    throw serde::serialization_error("not implemented");
+template <class S, class Output>
+void BinarySerializer<S, Output>::serialize_f64(double) {
+    SERDE_THROW(serde::serialization_error("not implemented"));
 }
 
-template <class S>
-void BinarySerializer<S>::serialize_char(char32_t) {
-    throw serde::serialization_error("not implemented");
+template <class S, class Output>
+void BinarySerializer<S, Output>::serialize_char(char32_t) {
+    SERDE_THROW(serde::serialization_error("not implemented"));
 }
 
-template <class S>
-void BinarySerializer<S>::serialize_bool(bool value) {
-    bytes_.push_back((uint8_t)value);
+template <class S, class Output>
+void BinarySerializer<S, Output>::serialize_bool(bool value) {
+    output_.write_byte((uint8_t)value);
+    count_bytes_written(1);
 }
 
-template <class S>
-void BinarySerializer<S>::serialize_u8(uint8_t value) {
-    bytes_.push_back(value);
+template <class S, class Output>
+void BinarySerializer<S, Output>::serialize_u8(uint8_t value) {
+    output_.write_byte(value);
+    count_bytes_written(1);
 }
 
-template <class S>
-void BinarySerializer<S>::serialize_u16(uint16_t value) {
-    bytes_.push_back((uint8_t)value);
-    bytes_.push_back((uint8_t)(value >> 8));
+template <class S, class Output>
+template <typename T>
+void BinarySerializer<S, Output>::write_le(T value) {
+    uint8_t buffer[sizeof(T)];
+    store_le(buffer, value);
+    output_.write(buffer, sizeof(T));
+    count_bytes_written(sizeof(T));
 }
 
-template <class S>
-void BinarySerializer<S>::serialize_u32(uint32_t value) {
-    bytes_.push_back((uint8_t)value);
-    bytes_.push_back((uint8_t)(value >> 8));
-    bytes_.push_back((uint8_t)(value >> 16));
-    bytes_.push_back((uint8_t)(value >> 24));
+template <class S, class Output>
+void BinarySerializer<S, Output>::serialize_u16(uint16_t value) {
+    write_le(value);
 }
 
-template <class S>
-void BinarySerializer<S>::serialize_u64(uint64_t value) {
-    bytes_.push_back((uint8_t)value);
-    bytes_.push_back((uint8_t)(value >> 8));
-    bytes_.push_back((uint8_t)(value >> 16));
-    bytes_.push_back((uint8_t)(value >> 24));
-    bytes_.push_back((uint8_t)(value >> 32));
-    bytes_.push_back((uint8_t)(value >> 40));
-    bytes_.push_back((uint8_t)(value >> 48));
-    bytes_.push_back((uint8_t)(value >> 56));
+template <class S, class Output>
+void BinarySerializer<S, Output>::serialize_u32(uint32_t value) {
+    write_le(value);
 }
 
-template <class S>
-void BinarySerializer<S>::serialize_u128(const uint128_t &value) {
-    serialize_u64(value.low);
-    serialize_u64(value.high);
+template <class S, class Output>
+void BinarySerializer<S, Output>::serialize_u64(uint64_t value) {
+    write_le(value);
 }
 
-template <class S>
-void BinarySerializer<S>::serialize_i8(int8_t value) {
+template <class S, class Output>
+void BinarySerializer<S, Output>::serialize_u128(const uint128_t &value) {
+    uint8_t buffer[16];
+    store_le(buffer, value.low);
+    store_le(buffer + 8, value.high);
+    output_.write(buffer, 16);
+    count_bytes_written(16);
+}
+
+template <class S, class Output>
+void BinarySerializer<S, Output>::serialize_i8(int8_t value) {
     serialize_u8((uint8_t)value);
 }
 
-template <class S>
-void BinarySerializer<S>::serialize_i16(int16_t value) {
+template <class S, class Output>
+void BinarySerializer<S, Output>::serialize_i16(int16_t value) {
     serialize_u16((uint16_t)value);
 }
 
-template <class S>
-void BinarySerializer<S>::serialize_i32(int32_t value) {
+template <class S, class Output>
+void BinarySerializer<S, Output>::serialize_i32(int32_t value) {
     serialize_u32((uint32_t)value);
 }
 
-template <class S>
-void BinarySerializer<S>::serialize_i64(int64_t value) {
+template <class S, class Output>
+void BinarySerializer<S, Output>::serialize_i64(int64_t value) {
     serialize_u64((uint64_t)value);
 }
 
-template <class S>
-void BinarySerializer<S>::serialize_i128(const int128_t &value) {
-    serialize_u64(value.low);
-    serialize_i64(value.high);
+template <class S, class Output>
+void BinarySerializer<S, Output>::serialize_i128(const int128_t &value) {
+    serialize_u128({(uint64_t)value.high, value.low});
 }
 
-template <class S>
-void BinarySerializer<S>::serialize_option_tag(bool value) {
+template <class S, class Output>
+void BinarySerializer<S, Output>::serialize_option_tag(bool value) {
     serialize_bool(value);
 }
 
-template <class S>
-size_t BinarySerializer<S>::get_buffer_offset() {
-    return bytes_.size();
+template <class S, class Output>
+void BinarySerializer<S, Output>::serialize_raw_bytes(const uint8_t *bytes,
+                                              size_t len) {
+    output_.write(bytes, len);
+    count_bytes_written(len);
 }
 
-template <class S>
-void BinarySerializer<S>::increase_container_depth() {
+template <class S, class Output>
+template <typename T>
+size_t BinarySerializer<S, Output>::serialized_size(const T &value) {
+    if constexpr (S::fixed_width_integers && EncodedSize<T>::is_static) {
+        return EncodedSize<T>::value;
+    } else {
+        typename S::template with_output<SizeCounter> counter;
+        Serializable<T>::serialize(value, counter);
+        return counter.get_buffer_offset();
+    }
+}
+
+template <class S, class Output>
+template <typename T>
+EncodedBatch
+BinarySerializer<S, Output>::serialize_batch(const std::vector<T> &values) {
+    EncodedBatch batch;
+    batch.offsets.reserve(values.size() + 1);
+    if constexpr (S::fixed_width_integers && EncodedSize<T>::is_static) {
+        batch.bytes.reserve(values.size() * EncodedSize<T>::value);
+    }
+    typename S::template with_output<VectorRefOutput> serializer(
+        VectorRefOutput(batch.bytes));
+    for (const auto &value : values) {
+        batch.offsets.push_back(serializer.get_buffer_offset());
+        Serializable<T>::serialize(value, serializer);
+    }
+    batch.offsets.push_back(serializer.get_buffer_offset());
+    return batch;
+}
+
+template <class S, class Output>
+template <typename T, typename Allocator>
+void BinarySerializer<S, Output>::serialize_elements_in_parallel(
+    const std::vector<T, Allocator> &value) {
+    serialize_in_parallel(value.begin(), value.size(), false,
+                          [](const T &item, auto &serializer) {
+                              Serializable<T>::serialize(item, serializer);
+                          });
+}
+
+template <class S, class Output>
+template <typename Map>
+void BinarySerializer<S, Output>::serialize_entries_in_parallel(
+    const Map &value) {
+    using K = typename Map::key_type;
+    using V = typename Map::mapped_type;
+    serialize_in_parallel(value.begin(), value.size(),
+                          S::enforce_strict_map_ordering,
+                          [](const auto &item, auto &serializer) {
+                              Serializable<K>::serialize(item.first,
+                                                         serializer);
+                              Serializable<V>::serialize(item.second,
+                                                         serializer);
+                          });
+}
+
+template <class S, class Output>
+template <typename Iterator, typename Encode>
+void BinarySerializer<S, Output>::serialize_in_parallel(Iterator begin,
+                                                        size_t len,
+                                                        bool sort_items,
+                                                        Encode encode) {
+    using Part = typename S::template with_output<VectorOutput>;
+    using Counter = typename S::template with_output<SizeCounter>;
+    // Start and end of the items in each part.
+    using Slices = std::vector<std::pair<size_t, size_t>>;
+
+    constexpr size_t group_size = 64;
+    size_t groups = (len + group_size - 1) / group_size;
+    std::vector<Iterator> starts;
+    starts.reserve(groups);
+    for (size_t g = 0; g < groups; g++) {
+        starts.push_back(begin);
+        std::advance(begin, std::min(group_size, len - g * group_size));
+    }
+    std::vector<Part> parts(groups);
+    std::vector<Slices> slices(sort_items ? groups : 0);
+#if SERDE_EXCEPTIONS
+    std::vector<std::exception_ptr> errors(groups);
+#endif
+
+    executor_(groups, [&](size_t g) {
+        auto &part = parts[g];
+        size_t count = std::min(group_size, len - g * group_size);
+#if SERDE_EXCEPTIONS
+        try {
+#endif
+            Counter counter;
+            counter.container_depth_budget_ = container_depth_budget_;
+            auto it = starts[g];
+            for (size_t i = 0; i < count; i++, ++it) {
+                encode(*it, counter);
+            }
+            part.reserve(counter.get_buffer_offset());
+            part.container_depth_budget_ = container_depth_budget_;
+            it = starts[g];
+            for (size_t i = 0; i < count; i++, ++it) {
+                auto start = part.get_buffer_offset();
+                encode(*it, part);
+                if (sort_items) {
+                    slices[g].emplace_back(start, part.get_buffer_offset());
+                }
+            }
+            if (sort_items) {
+                const uint8_t *data = part.output().data();
+                std::sort(slices[g].begin(), slices[g].end(),
+                          [data](const auto &e1, const auto &e2) {
+                              return std::lexicographical_compare(
+                                  data + e1.first, data + e1.second,
+                                  data + e2.first, data + e2.second);
+                          });
+            }
+#if SERDE_EXCEPTIONS
+        } catch (...) {
+            errors[g] = std::current_exception();
+        }
+#endif
+    });
+#if SERDE_EXCEPTIONS
+    for (const auto &error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+#endif
+
+    size_t total = 0;
+    for (auto &part : parts) {
+        total += part.get_buffer_offset();
+    }
+    output_.reserve(output_.size() + total);
+    if (!sort_items) {
+        for (auto &part : parts) {
+            output_.write(part.output().data(), part.get_buffer_offset());
+        }
+        return;
+    }
+
+    // Merge the sorted groups, starting from the smallest head item.
+    std::vector<size_t> heads(groups, 0);
+    auto head = [&](size_t g) {
+        const uint8_t *data = parts[g].output().data();
+        const auto &slice = slices[g][heads[g]];
+        return std::make_pair(data + slice.first, data + slice.second);
+    };
+    auto greater = [&](size_t g1, size_t g2) {
+        auto h1 = head(g1);
+        auto h2 = head(g2);
+        return std::lexicographical_compare(h2.first, h2.second, h1.first,
+                                            h1.second);
+    };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(greater)> queue(
+        greater);
+    for (size_t g = 0; g < groups; g++) {
+        queue.push(g);
+    }
+    while (!queue.empty()) {
+        auto g = queue.top();
+        queue.pop();
+        auto h = head(g);
+        output_.write(h.first, h.second - h.first);
+        if (++heads[g] < slices[g].size()) {
+            queue.push(g);
+        }
+    }
+}
+
+template <class S, class Output>
+size_t BinarySerializer<S, Output>::get_buffer_offset() {
+    return output_.size();
+}
+
+template <class S, class Output>
+void BinarySerializer<S, Output>::increase_container_depth() {
     if (container_depth_budget_ == 0) {
-        throw serialization_error("Too many nested containers");
+        SERDE_THROW(serialization_error("Too many nested containers"));
     }
     container_depth_budget_--;
+    SERDE_COUNT_MAX(max_depth, max_container_depth_ - container_depth_budget_);
 }
 
-template <class S>
-void BinarySerializer<S>::decrease_container_depth() {
+template <class S, class Output>
+void BinarySerializer<S, Output>::decrease_container_depth() {
     container_depth_budget_++;
 }
 
+template <class S, class Output>
+void BinarySerializer<S, Output>::reset() {
+    output_.reset();
+    container_depth_budget_ = max_container_depth_;
+}
+
+template <class D>
+void BinaryDeserializer<D>::fail(deserialization_errc code) {
+    fail_at(code, base_ + pos_);
+}
+
+template <class D>
+void BinaryDeserializer<D>::fail_at(deserialization_errc code, size_t offset) {
+    if (throw_on_error_) {
+        SERDE_THROW(deserialization_error(error_message(code)));
+    }
+    if (error_ == deserialization_errc::ok) {
+        error_ = code;
+        error_offset_ = offset;
+    }
+    pos_ = size_;
+}
+
+template <class D>
+bool BinaryDeserializer<D>::fill(size_t len) {
+    if (!source_ || has_failed()) {
+        return false;
+    }
+    // Discard the bytes that were consumed and are not held.
+    size_t keep_from = holds_ > 0 ? hold_start_ - base_ : pos_;
+    if (keep_from > 0) {
+        std::memmove(owned_bytes_.data(), owned_bytes_.data() + keep_from,
+                     size_ - keep_from);
+        size_ -= keep_from;
+        pos_ -= keep_from;
+        base_ += keep_from;
+    }
+    while (size_ - pos_ < len) {
+        // Grow with the input actually received, not with untrusted lengths.
+        size_t missing = len - (size_ - pos_);
+        size_t capacity =
+            size_ + std::max(source_chunk_size, std::min(missing, size_));
+        if (owned_bytes_.size() < capacity) {
+            owned_bytes_.resize(capacity);
+        }
+        size_t count = source_(owned_bytes_.data() + size_,
+                               owned_bytes_.size() - size_);
+        if (count == 0) {
+            break;
+        }
+        size_ += count;
+    }
+    bytes_ = owned_bytes_.data();
+    return size_ - pos_ >= len;
+}
+
 template <class D>
 uint8_t BinaryDeserializer<D>::read_byte() {
-    if (pos_ >= bytes_.size()) {
-        throw serde::deserialization_error("Input is not large enough");
+    if (pos_ >= size_ && !fill(1)) {
+        fail(deserialization_errc::input_too_short);
+        return 0;
     }
-    return bytes_.at(pos_++);
+    SERDE_COUNT(bytes_read, 1);
+    return bytes_[pos_++];
 }
 
-inline bool is_valid_utf8(const std::string &input) {
-    uint8_t trailing_digits = 0;
-    for (uint8_t byte : input) {
-        if (trailing_digits == 0) {
-            // Start new codepoint.
-            if (byte >> 7 == 0) {
-                // ASCII character
-            } else if (byte >> 5 == 0b110) {
-                // Expecting a 2-byte codepoint
-                trailing_digits = 1;
-            } else if (byte >> 4 == 0b1110) {
-                // Expecting a 3-byte codepoint
-                trailing_digits = 2;
-            } else if (byte >> 3 == 0b11110) {
-                // Expecting a 4-byte codepoint
-                trailing_digits = 3;
-            } else {
-                return false;
+template <class D>
+const uint8_t *BinaryDeserializer<D>::read_bytes(size_t len) {
+    if (len > size_ - pos_ && !fill(len)) {
+        fail(deserialization_errc::input_too_short);
+        return nullptr;
+    }
+    auto result = bytes_ + pos_;
+    pos_ += len;
+    SERDE_COUNT(bytes_read, len);
+    return result;
+}
+
+template <class D>
+template <typename T>
+T BinaryDeserializer<D>::read_le() {
+    auto bytes = read_bytes(sizeof(T));
+    return bytes != nullptr ? load_le<T>(bytes) : 0;
+}
+
+// Validate UTF-8 following the table of well-formed byte sequences of the
+// Unicode standard (table 3-7): overlong encodings, surrogates and code points
+// above U+10FFFF are rejected.
+inline bool is_valid_utf8_scalar(const uint8_t *input, size_t len) {
+    size_t i = 0;
+    while (i < len) {
+        // Skip ASCII characters 8 bytes at a time.
+        if (len - i >= 8) {
+            uint64_t word;
+            std::memcpy(&word, input + i, 8);
+            if ((word & 0x8080808080808080ull) == 0) {
+                i += 8;
+                continue;
+            }
+        }
+        uint8_t byte = input[i];
+        if (byte < 0x80) {
+            i++;
+            continue;
+        }
+        // Number of continuation bytes and range of the first one.
+        size_t trailing_digits;
+        uint8_t low = 0x80;
+        uint8_t high = 0xBF;
+        if (byte >= 0xC2 && byte <= 0xDF) {
+            trailing_digits = 1;
+        } else if (byte >= 0xE0 && byte <= 0xEF) {
+            trailing_digits = 2;
+            if (byte == 0xE0) {
+                low = 0xA0; // overlong
+            } else if (byte == 0xED) {
+                high = 0x9F; // surrogates
+            }
+        } else if (byte >= 0xF0 && byte <= 0xF4) {
+            trailing_digits = 3;
+            if (byte == 0xF0) {
+                low = 0x90; // overlong
+            } else if (byte == 0xF4) {
+                high = 0x8F; // above U+10FFFF
             }
         } else {
-            // Process "trailing digit".
-            if (byte >> 6 != 0b10) {
+            return false;
+        }
+        if (len - i <= trailing_digits) {
+            return false;
+        }
+        if (input[i + 1] < low || input[i + 1] > high) {
+            return false;
+        }
+        for (size_t k = 2; k <= trailing_digits; k++) {
+            if ((input[i + k] & 0xC0) != 0x80) {
                 return false;
             }
-            trailing_digits -= 1;
         }
+        i += trailing_digits + 1;
     }
-    return trailing_digits == 0;
+    return true;
+}
+
+#if defined(__SSSE3__) || (defined(__aarch64__) && defined(__ARM_NEON))
+// Vectorized validation of 16-byte blocks adapted from "Validating UTF-8 In
+// Less Than One Instruction Per Byte" (Keiser and Lemire, 2021). Each block
+// is checked against its three previous bytes using three nibble lookups.
+namespace utf8_tables {
+
+constexpr uint8_t TOO_SHORT = 1 << 0;
+constexpr uint8_t TOO_LONG = 1 << 1;
+constexpr uint8_t OVERLONG_3 = 1 << 2;
+constexpr uint8_t TOO_LARGE = 1 << 3;
+constexpr uint8_t SURROGATE = 1 << 4;
+constexpr uint8_t OVERLONG_2 = 1 << 5;
+constexpr uint8_t TOO_LARGE_1000 = 1 << 6;
+constexpr uint8_t OVERLONG_4 = 1 << 6;
+constexpr uint8_t TWO_CONTS = 1 << 7;
+constexpr uint8_t CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+// Indexed by the high nibble of the previous byte.
+alignas(16) constexpr uint8_t byte_1_high[16] = {
+    TOO_LONG,
+    TOO_LONG,
+    TOO_LONG,
+    TOO_LONG,
+    TOO_LONG,
+    TOO_LONG,
+    TOO_LONG,
+    TOO_LONG,
+    TWO_CONTS,
+    TWO_CONTS,
+    TWO_CONTS,
+    TWO_CONTS,
+    TOO_SHORT | OVERLONG_2,
+    TOO_SHORT,
+    TOO_SHORT | OVERLONG_3 | SURROGATE,
+    TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4,
+};
+
+// Indexed by the low nibble of the previous byte.
+alignas(16) constexpr uint8_t byte_1_low[16] = {
+    CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+    CARRY | OVERLONG_2,
+    CARRY,
+    CARRY,
+    CARRY | TOO_LARGE,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+};
+
+// Indexed by the high nibble of the current byte.
+alignas(16) constexpr uint8_t byte_2_high[16] = {
+    TOO_SHORT,
+    TOO_SHORT,
+    TOO_SHORT,
+    TOO_SHORT,
+    TOO_SHORT,
+    TOO_SHORT,
+    TOO_SHORT,
+    TOO_SHORT,
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 |
+        OVERLONG_4,
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+    TOO_SHORT,
+    TOO_SHORT,
+    TOO_SHORT,
+    TOO_SHORT,
+};
+
+// A block is incomplete if one of its last three bytes starts a sequence that
+// does not fit.
+alignas(16) constexpr uint8_t max_complete[16] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,        0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xF0 - 1, 0xE0 - 1, 0xC0 - 1,
+};
+
+} // end of namespace utf8_tables
+#endif
+
+#if defined(__SSSE3__)
+inline bool is_valid_utf8_simd(const uint8_t *input, size_t len) {
+    using namespace utf8_tables;
+    const __m128i table_1_high = _mm_load_si128((const __m128i *)byte_1_high);
+    const __m128i table_1_low = _mm_load_si128((const __m128i *)byte_1_low);
+    const __m128i table_2_high = _mm_load_si128((const __m128i *)byte_2_high);
+    const __m128i incomplete = _mm_load_si128((const __m128i *)max_complete);
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    __m128i error = _mm_setzero_si128();
+    __m128i previous = _mm_setzero_si128();
+    __m128i previous_incomplete = _mm_setzero_si128();
+
+    auto check_block = [&](__m128i block) {
+        if (_mm_movemask_epi8(block) == 0) {
+            // ASCII block: only an unfinished sequence may be an error.
+            error = _mm_or_si128(error, previous_incomplete);
+            previous_incomplete = _mm_setzero_si128();
+        } else {
+            __m128i prev1 = _mm_alignr_epi8(block, previous, 15);
+            __m128i high1 = _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble);
+            __m128i low1 = _mm_and_si128(prev1, nibble);
+            __m128i high2 = _mm_and_si128(_mm_srli_epi16(block, 4), nibble);
+            __m128i special = _mm_and_si128(
+                _mm_and_si128(_mm_shuffle_epi8(table_1_high, high1),
+                              _mm_shuffle_epi8(table_1_low, low1)),
+                _mm_shuffle_epi8(table_2_high, high2));
+            // Third and fourth bytes of a sequence must be continuations.
+            __m128i prev2 = _mm_alignr_epi8(block, previous, 14);
+            __m128i prev3 = _mm_alignr_epi8(block, previous, 13);
+            __m128i must_be_continuation = _mm_and_si128(
+                _mm_or_si128(_mm_subs_epu8(prev2, _mm_set1_epi8(0xE0 - 0x80)),
+                             _mm_subs_epu8(prev3, _mm_set1_epi8(0xF0 - 0x80))),
+                _mm_set1_epi8((char)0x80));
+            error = _mm_or_si128(error,
+                                 _mm_xor_si128(must_be_continuation, special));
+            previous_incomplete = _mm_subs_epu8(block, incomplete);
+        }
+        previous = block;
+    };
+
+    size_t i = 0;
+    for (; len - i >= 16; i += 16) {
+        check_block(_mm_loadu_si128((const __m128i *)(input + i)));
+    }
+    if (i < len) {
+        // Pad the last block with ASCII zeros.
+        alignas(16) uint8_t last[16] = {0};
+        std::memcpy(last, input + i, len - i);
+        check_block(_mm_load_si128((const __m128i *)last));
+    }
+    error = _mm_or_si128(error, previous_incomplete);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) ==
+           0xFFFF;
+}
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+inline bool is_valid_utf8_simd(const uint8_t *input, size_t len) {
+    using namespace utf8_tables;
+    const uint8x16_t table_1_high = vld1q_u8(byte_1_high);
+    const uint8x16_t table_1_low = vld1q_u8(byte_1_low);
+    const uint8x16_t table_2_high = vld1q_u8(byte_2_high);
+    const uint8x16_t incomplete = vld1q_u8(max_complete);
+    const uint8x16_t nibble = vdupq_n_u8(0x0F);
+    uint8x16_t error = vdupq_n_u8(0);
+    uint8x16_t previous = vdupq_n_u8(0);
+    uint8x16_t previous_incomplete = vdupq_n_u8(0);
+
+    auto check_block = [&](uint8x16_t block) {
+        if (vmaxvq_u8(block) < 0x80) {
+            // ASCII block: only an unfinished sequence may be an error.
+            error = vorrq_u8(error, previous_incomplete);
+            previous_incomplete = vdupq_n_u8(0);
+        } else {
+            uint8x16_t prev1 = vextq_u8(previous, block, 15);
+            uint8x16_t special = vandq_u8(
+                vandq_u8(vqtbl1q_u8(table_1_high, vshrq_n_u8(prev1, 4)),
+                         vqtbl1q_u8(table_1_low, vandq_u8(prev1, nibble))),
+                vqtbl1q_u8(table_2_high, vshrq_n_u8(block, 4)));
+            // Third and fourth bytes of a sequence must be continuations.
+            uint8x16_t prev2 = vextq_u8(previous, block, 14);
+            uint8x16_t prev3 = vextq_u8(previous, block, 13);
+            uint8x16_t must_be_continuation =
+                vandq_u8(vorrq_u8(vqsubq_u8(prev2, vdupq_n_u8(0xE0 - 0x80)),
+                                  vqsubq_u8(prev3, vdupq_n_u8(0xF0 - 0x80))),
+                         vdupq_n_u8(0x80));
+            error = vorrq_u8(error, veorq_u8(must_be_continuation, special));
+            previous_incomplete = vqsubq_u8(block, incomplete);
+        }
+        previous = block;
+    };
+
+    size_t i = 0;
+    for (; len - i >= 16; i += 16) {
+        check_block(vld1q_u8(input + i));
+    }
+    if (i < len) {
+        // Pad the last block with ASCII zeros.
+        uint8_t last[16] = {0};
+        std::memcpy(last, input + i, len - i);
+        check_block(vld1q_u8(last));
+    }
+    error = vorrq_u8(error, previous_incomplete);
+    return vmaxvq_u8(error) == 0;
+}
+#endif
+
+inline bool is_valid_utf8(const uint8_t *input, size_t len) {
+    SERDE_COUNT(strings_validated, 1);
+#if defined(__SSSE3__) || (defined(__aarch64__) && defined(__ARM_NEON))
+    if (len >= 16) {
+        return is_valid_utf8_simd(input, len);
+    }
+#endif
+    return is_valid_utf8_scalar(input, len);
+}
+
+inline bool is_valid_utf8(const std::string &input) {
+    return is_valid_utf8(reinterpret_cast<const uint8_t *>(input.data()),
+                         input.size());
 }
 
 template <class D>
-std::string BinaryDeserializer<D>::deserialize_str() {
+template <typename Allocator>
+std::basic_string<char, std::char_traits<char>, Allocator>
+BinaryDeserializer<D>::deserialize_str(const Allocator &allocator) {
     auto len = static_cast<D *>(this)->deserialize_len();
-    std::string result;
-    result.reserve(len);
-    for (size_t i = 0; i < len; i++) {
-        result.push_back(read_byte());
+    auto bytes = read_bytes(len);
+    if (bytes == nullptr) {
+        return std::basic_string<char, std::char_traits<char>, Allocator>(
+            allocator);
     }
-    if (!is_valid_utf8(result)) {
-        throw serde::deserialization_error("Invalid UTF8 string: " + result);
+    if (!is_valid_utf8(bytes, len)) {
+        fail(deserialization_errc::invalid_utf8);
+        return std::basic_string<char, std::char_traits<char>, Allocator>(
+            allocator);
     }
+    std::basic_string<char, std::char_traits<char>, Allocator> result(
+        reinterpret_cast<const char *>(bytes), len, allocator);
+    // Short strings are stored inline.
+    SERDE_COUNT(allocations, result.capacity() > std::string().capacity());
     return result;
 }
 
+template <class D>
+template <typename Allocator>
+void BinaryDeserializer<D>::deserialize_str_into(
+    std::basic_string<char, std::char_traits<char>, Allocator> &value) {
+    auto len = static_cast<D *>(this)->deserialize_len();
+    auto bytes = read_bytes(len);
+    if (bytes == nullptr || !is_valid_utf8(bytes, len)) {
+        if (bytes != nullptr) {
+            fail(deserialization_errc::invalid_utf8);
+        }
+        value.clear();
+        return;
+    }
+    SERDE_COUNT(allocations, len > value.capacity());
+    value.assign(reinterpret_cast<const char *>(bytes), len);
+}
+
+template <class D>
+void BinaryDeserializer<D>::skip_str() {
+    auto len = static_cast<D *>(this)->deserialize_len();
+    auto bytes = read_bytes(len);
+    if (bytes != nullptr && !is_valid_utf8(bytes, len)) {
+        fail(deserialization_errc::invalid_utf8);
+    }
+}
+
 template <class D>
 std::monostate BinaryDeserializer<D>::deserialize_unit() {
     return {};
@@ -266,17 +1510,20 @@ std::monostate BinaryDeserializer<D>::deserialize_unit() {
 
 template <class D>
 float BinaryDeserializer<D>::deserialize_f32() {
-    throw serde::deserialization_error("not implemented");
+    fail(deserialization_errc::not_implemented);
+    return 0;
 }
 
 template <class D>
 double BinaryDeserializer<D>::deserialize_f64() {
-    throw serde::deserialization_error("not implemented");
+    fail(deserialization_errc::not_implemented);
+    return 0;
 }
 
 template <class D>
 char32_t BinaryDeserializer<D>::deserialize_char() {
-    throw serde::deserialization_error("not implemented");
+    fail(deserialization_errc::not_implemented);
+    return 0;
 }
 
 template <class D>
@@ -287,7 +1534,8 @@ bool BinaryDeserializer<D>::deserialize_bool() {
     case 1:
         return true;
     default:
-        throw serde::deserialization_error("Invalid boolean value");
+        fail(deserialization_errc::invalid_bool);
+        return false;
     }
 }
 
@@ -298,41 +1546,28 @@ uint8_t BinaryDeserializer<D>::deserialize_u8() {
 
 template <class D>
 uint16_t BinaryDeserializer<D>::deserialize_u16() {
-    uint16_t val = 0;
-    val |= (uint16_t)read_byte();
-    val |= (uint16_t)read_byte() << 8;
-    return val;
+    return read_le<uint16_t>();
 }
 
 template <class D>
 uint32_t BinaryDeserializer<D>::deserialize_u32() {
-    uint32_t val = 0;
-    val |= (uint32_t)read_byte();
-    val |= (uint32_t)read_byte() << 8;
-    val |= (uint32_t)read_byte() << 16;
-    val |= (uint32_t)read_byte() << 24;
-    return val;
+    return read_le<uint32_t>();
 }
 
 template <class D>
 uint64_t BinaryDeserializer<D>::deserialize_u64() {
-    uint64_t val = 0;
-    val |= (uint64_t)read_byte();
-    val |= (uint64_t)read_byte() << 8;
-    val |= (uint64_t)read_byte() << 16;
-    val |= (uint64_t)read_byte() << 24;
-    val |= (uint64_t)read_byte() << 32;
-    val |= (uint64_t)read_byte() << 40;
-    val |= (uint64_t)read_byte() << 48;
-    val |= (uint64_t)read_byte() << 56;
-    return val;
+    return read_le<uint64_t>();
 }
 
 template <class D>
 uint128_t BinaryDeserializer<D>::deserialize_u128() {
+    auto bytes = read_bytes(16);
+    if (bytes == nullptr) {
+        return {0, 0};
+    }
     uint128_t result;
-    result.low = deserialize_u64();
-    result.high = deserialize_u64();
+    result.low = load_le<uint64_t>(bytes);
+    result.high = load_le<uint64_t>(bytes + 8);
     return result;
 }
 
@@ -358,10 +1593,8 @@ int64_t BinaryDeserializer<D>::deserialize_i64() {
 
 template <class D>
 int128_t BinaryDeserializer<D>::deserialize_i128() {
-    int128_t result;
-    result.low = deserialize_u64();
-    result.high = deserialize_i64();
-    return result;
+    auto value = deserialize_u128();
+    return {(int64_t)value.high, value.low};
 }
 
 template <class D>
@@ -369,17 +1602,138 @@ bool BinaryDeserializer<D>::deserialize_option_tag() {
     return deserialize_bool();
 }
 
+template <class D>
+template <typename T>
+std::vector<T>
+BinaryDeserializer<D>::deserialize_batch(const uint8_t *bytes, size_t size,
+                                         const std::vector<size_t> &offsets) {
+    std::vector<T> values;
+    if (offsets.empty()) {
+        return values;
+    }
+    values.reserve(offsets.size() - 1);
+    D deserializer(bytes, size);
+    if (offsets.front() > size || offsets.back() > size) {
+        deserializer.fail(deserialization_errc::input_too_short);
+        return values;
+    }
+    deserializer.pos_ = offsets.front();
+    for (size_t i = 0; i + 1 < offsets.size(); i++) {
+        values.emplace_back(Deserializable<T>::deserialize(deserializer));
+        auto end = deserializer.get_buffer_offset();
+        if (end < offsets[i + 1]) {
+            deserializer.fail(deserialization_errc::trailing_bytes);
+        } else if (end > offsets[i + 1]) {
+            deserializer.fail(deserialization_errc::input_too_short);
+        }
+    }
+    return values;
+}
+
+template <class D>
+template <typename T, typename Allocator>
+void BinaryDeserializer<D>::deserialize_elements_in_parallel(
+    std::vector<T, Allocator> &result, size_t len) {
+    auto &self = *static_cast<D *>(this);
+    // Find the boundaries of the elements, validating them on the way.
+    std::vector<size_t> offsets;
+    offsets.reserve(bounded_capacity<T>(len, get_remaining_bytes()) + 1);
+    for (size_t i = 0; i < len && !has_failed(); i++) {
+        offsets.push_back(pos_);
+        Skippable<T>::skip(self);
+    }
+    if (has_failed()) {
+        return;
+    }
+    offsets.push_back(pos_);
+
+    constexpr size_t group_size = 64;
+    size_t groups = (len + group_size - 1) / group_size;
+    std::vector<std::vector<T, Allocator>> parts(
+        groups, std::vector<T, Allocator>(make_allocator<Allocator>(self)));
+    std::vector<deserialization_failure> failures(
+        groups, {deserialization_errc::ok, 0});
+#if SERDE_EXCEPTIONS
+    // Exceptions other than decoding errors, such as allocation failures.
+    std::vector<std::exception_ptr> errors(groups);
+#endif
+    executor_(groups, [&](size_t g) {
+#if SERDE_EXCEPTIONS
+        try {
+#endif
+            size_t begin = g * group_size;
+            size_t end = std::min(len, begin + group_size);
+            D group(bytes_, size_);
+            group.pos_ = offsets[begin];
+            group.container_depth_budget_ = container_depth_budget_;
+            group.throw_on_error_ = false;
+#if defined(__cpp_lib_memory_resource)
+            group.memory_resource_ = memory_resource_;
+#endif
+            auto &part = parts[g];
+            part.reserve(end - begin);
+            for (size_t i = begin; i < end && !group.has_failed(); i++) {
+                part.emplace_back(Deserializable<T>::deserialize(group));
+            }
+            failures[g] = group.get_failure();
+#if SERDE_EXCEPTIONS
+        } catch (...) {
+            errors[g] = std::current_exception();
+        }
+#endif
+    });
+#if SERDE_EXCEPTIONS
+    for (const auto &error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+#endif
+    for (const auto &failure : failures) {
+        if (failure.code != deserialization_errc::ok) {
+            pos_ = failure.offset;
+            fail(failure.code);
+            return;
+        }
+    }
+    result.reserve(len);
+    for (auto &part : parts) {
+        for (auto &value : part) {
+            result.emplace_back(std::move(value));
+        }
+    }
+}
+
+template <class D>
+const uint8_t *BinaryDeserializer<D>::deserialize_raw_bytes(size_t len) {
+    return read_bytes(len);
+}
+
 template <class D>
 size_t BinaryDeserializer<D>::get_buffer_offset() {
-    return pos_;
+    return base_ + pos_;
+}
+
+template <class D>
+size_t BinaryDeserializer<D>::get_remaining_bytes() {
+    return size_ - pos_;
+}
+
+template <class D>
+std::vector<uint8_t> BinaryDeserializer<D>::take_buffered_bytes() {
+    std::vector<uint8_t> result(bytes_ + pos_, bytes_ + size_);
+    size_ = pos_;
+    return result;
 }
 
 template <class S>
 void BinaryDeserializer<S>::increase_container_depth() {
     if (container_depth_budget_ == 0) {
-        throw deserialization_error("Too many nested containers");
+        fail(deserialization_errc::too_many_nested_containers);
+        return;
     }
     container_depth_budget_--;
+    SERDE_COUNT_MAX(max_depth, max_container_depth_ - container_depth_budget_);
 }
 
 template <class S>
@@ -13,80 +13,516 @@ constexpr size_t BINCODE_MAX_LENGTH = (1ull << 31) - 1;
 
 namespace serde {
 
-class BincodeSerializer : public BinarySerializer<BincodeSerializer> {
-    using Parent = BinarySerializer<BincodeSerializer>;
+// Encodings of integers, lengths and variant indices in Bincode. These match
+// the `IntEncoding` option of `bincode::Options` in Rust.
+enum class bincode_int_encoding {
+    // Integers use their fixed width, and lengths are written as u64 (as by
+    // `bincode::serialize`).
+    fixint,
+    // Unsigned integers of 2 bytes or more are written on one byte up to 250,
+    // otherwise after a tag byte 251, 252, 253 or 254 announcing a u16, u32,
+    // u64 or u128. Signed integers are zigzag-encoded first. This is the
+    // default of `bincode::options()`.
+    varint,
+};
+
+// Byte order of fixed-width integers and floats.
+enum class bincode_endianness { little, big };
+
+// Compile-time configuration of the Bincode serializer and deserializer.
+template <bincode_int_encoding IntEncoding, bincode_endianness Endianness>
+struct BincodeConfig {
+    static constexpr bincode_int_encoding int_encoding = IntEncoding;
+    static constexpr bincode_endianness endianness = Endianness;
+};
+
+using BincodeFixintConfig =
+    BincodeConfig<bincode_int_encoding::fixint, bincode_endianness::little>;
+using BincodeVarintConfig =
+    BincodeConfig<bincode_int_encoding::varint, bincode_endianness::little>;
+using BincodeBigEndianConfig =
+    BincodeConfig<bincode_int_encoding::fixint, bincode_endianness::big>;
+using BincodeVarintBigEndianConfig =
+    BincodeConfig<bincode_int_encoding::varint, bincode_endianness::big>;
+
+// Tag bytes of varint-encoded integers.
+constexpr uint8_t BINCODE_VARINT_MAX_SINGLE_BYTE = 250;
+constexpr uint8_t BINCODE_VARINT_U16_TAG = 251;
+constexpr uint8_t BINCODE_VARINT_U32_TAG = 252;
+constexpr uint8_t BINCODE_VARINT_U64_TAG = 253;
+constexpr uint8_t BINCODE_VARINT_U128_TAG = 254;
+
+// Whether values of type T are encoded as their in-memory representation
+// with the given configuration (see `is_memcpy_encodable`).
+template <class Config, typename T>
+constexpr bool is_bincode_memcpy_encodable =
+    (Config::int_encoding == bincode_int_encoding::fixint &&
+     (Config::endianness == bincode_endianness::little) ==
+         host_is_little_endian)
+        ? is_memcpy_encodable<T>
+        : std::is_same<T, uint8_t>::value || std::is_same<T, int8_t>::value;
+
+template <class Output = VectorOutput, class Config = BincodeFixintConfig>
+class BasicBincodeSerializer
+    : public BinarySerializer<BasicBincodeSerializer<Output, Config>, Output> {
+    using Parent =
+        BinarySerializer<BasicBincodeSerializer<Output, Config>, Output>;
+
+    static constexpr bool varint =
+        Config::int_encoding == bincode_int_encoding::varint;
+
+    template <typename T>
+    void write_fixed(T value);
+    void write_varint(uint64_t value);
+    void write_fixed_u128(const uint128_t &value);
 
   public:
-    BincodeSerializer() : Parent(SIZE_MAX) {}
+    template <class O>
+    using with_output = BasicBincodeSerializer<O, Config>;
+
+    explicit BasicBincodeSerializer(Output output = Output())
+        : Parent(SIZE_MAX, std::move(output)) {}
 
     void serialize_f32(float value);
     void serialize_f64(double value);
     void serialize_len(size_t value);
     void serialize_variant_index(uint32_t value);
 
+    void serialize_u16(uint16_t value);
+    void serialize_u32(uint32_t value);
+    void serialize_u64(uint64_t value);
+    void serialize_u128(const uint128_t &value);
+
+    void serialize_i16(int16_t value);
+    void serialize_i32(int32_t value);
+    void serialize_i64(int64_t value);
+    void serialize_i128(const int128_t &value);
+
+    template <typename T>
+    static constexpr bool is_bulk_copyable =
+        is_bincode_memcpy_encodable<Config, T>;
+    static constexpr bool fixed_width_integers = !varint;
+    static constexpr bool little_endian_integers =
+        Config::endianness == bincode_endianness::little;
     static constexpr bool enforce_strict_map_ordering = false;
 };
 
-class BincodeDeserializer : public BinaryDeserializer<BincodeDeserializer> {
-    using Parent = BinaryDeserializer<BincodeDeserializer>;
+template <class Config = BincodeFixintConfig>
+class BasicBincodeDeserializer
+    : public BinaryDeserializer<BasicBincodeDeserializer<Config>> {
+    using Parent = BinaryDeserializer<BasicBincodeDeserializer<Config>>;
+
+    static constexpr bool varint =
+        Config::int_encoding == bincode_int_encoding::varint;
+
+    template <typename T>
+    T read_fixed();
+    // Decode the rest of a varint after its first byte.
+    uint64_t finish_varint(uint8_t tag);
+    uint64_t read_varint() { return finish_varint(Parent::read_byte()); }
+    // Read a varint that must fit in `max`.
+    uint64_t read_varint_at_most(uint64_t max);
+    int64_t read_zigzag(int64_t min, int64_t max);
+    uint128_t read_fixed_u128();
 
   public:
-    BincodeDeserializer(std::vector<uint8_t> bytes)
+    BasicBincodeDeserializer(std::vector<uint8_t> bytes)
         : Parent(std::move(bytes), SIZE_MAX) {}
 
+    BasicBincodeDeserializer(const uint8_t *bytes, size_t size)
+        : Parent(bytes, size, SIZE_MAX) {}
+
+    explicit BasicBincodeDeserializer(Source source)
+        : Parent(std::move(source), SIZE_MAX) {}
+
     float deserialize_f32();
     double deserialize_f64();
     size_t deserialize_len();
     uint32_t deserialize_variant_index();
 
+    uint16_t deserialize_u16();
+    uint32_t deserialize_u32();
+    uint64_t deserialize_u64();
+    uint128_t deserialize_u128();
+
+    int16_t deserialize_i16();
+    int32_t deserialize_i32();
+    int64_t deserialize_i64();
+    int128_t deserialize_i128();
+
+    template <typename T>
+    static constexpr bool is_bulk_copyable =
+        is_bincode_memcpy_encodable<Config, T>;
+    static constexpr bool fixed_width_integers = !varint;
+    static constexpr bool little_endian_integers =
+        Config::endianness == bincode_endianness::little;
     static constexpr bool enforce_strict_map_ordering = false;
 };
 
+// Default configuration of the Bincode runtimes in other languages.
+using BincodeSerializer = BasicBincodeSerializer<>;
+using BincodeDeserializer = BasicBincodeDeserializer<>;
+
+template <class Output = VectorOutput>
+using BasicBincodeVarintSerializer =
+    BasicBincodeSerializer<Output, BincodeVarintConfig>;
+using BincodeVarintSerializer = BasicBincodeVarintSerializer<>;
+using BincodeVarintDeserializer = BasicBincodeDeserializer<BincodeVarintConfig>;
+
+template <class Output = VectorOutput>
+using BasicBincodeBigEndianSerializer =
+    BasicBincodeSerializer<Output, BincodeBigEndianConfig>;
+using BincodeBigEndianSerializer = BasicBincodeBigEndianSerializer<>;
+using BincodeBigEndianDeserializer =
+    BasicBincodeDeserializer<BincodeBigEndianConfig>;
+
+template <class Output = VectorOutput>
+using BasicBincodeVarintBigEndianSerializer =
+    BasicBincodeSerializer<Output, BincodeVarintBigEndianConfig>;
+using BincodeVarintBigEndianSerializer =
+    BasicBincodeVarintBigEndianSerializer<>;
+using BincodeVarintBigEndianDeserializer =
+    BasicBincodeDeserializer<BincodeVarintBigEndianConfig>;
+
 // Native floats and doubles must be IEEE-754 values of the expected size.
 static_assert(std::numeric_limits<float>::is_iec559);
 static_assert(std::numeric_limits<double>::is_iec559);
 static_assert(sizeof(float) == sizeof(uint32_t));
 static_assert(sizeof(double) == sizeof(uint64_t));
 
-inline void BincodeSerializer::serialize_f32(float value) {
-    Parent::serialize_u32(*reinterpret_cast<uint32_t *>(&value));
+// Zigzag encoding of signed integers: 0, -1, 1, -2, ... are mapped to 0, 1,
+// 2, 3, ...
+inline uint64_t zigzag_encode(int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+inline int64_t zigzag_decode(uint64_t value) {
+    return (int64_t)((value >> 1) ^ (0 - (value & 1)));
 }
 
-inline void BincodeSerializer::serialize_f64(double value) {
-    Parent::serialize_u64(*reinterpret_cast<uint64_t *>(&value));
+template <class Output, class Config>
+template <typename T>
+void BasicBincodeSerializer<Output, Config>::write_fixed(T value) {
+    if constexpr (Config::endianness == bincode_endianness::big) {
+        value = byte_swap(value);
+    }
+    Parent::write_le(value);
+}
+
+template <class Output, class Config>
+void BasicBincodeSerializer<Output, Config>::write_varint(uint64_t value) {
+    uint8_t buffer[9];
+    size_t len;
+    auto store = [&](auto fixed) {
+        if constexpr (Config::endianness == bincode_endianness::big) {
+            store_be(buffer + 1, fixed);
+        } else {
+            store_le(buffer + 1, fixed);
+        }
+        len = 1 + sizeof(fixed);
+    };
+    if (value <= BINCODE_VARINT_MAX_SINGLE_BYTE) {
+        buffer[0] = (uint8_t)value;
+        len = 1;
+    } else if (value <= UINT16_MAX) {
+        buffer[0] = BINCODE_VARINT_U16_TAG;
+        store((uint16_t)value);
+    } else if (value <= UINT32_MAX) {
+        buffer[0] = BINCODE_VARINT_U32_TAG;
+        store((uint32_t)value);
+    } else {
+        buffer[0] = BINCODE_VARINT_U64_TAG;
+        store(value);
+    }
+    this->output_.write(buffer, len);
+    this->count_bytes_written(len);
+}
+
+template <class Output, class Config>
+void BasicBincodeSerializer<Output, Config>::write_fixed_u128(
+    const uint128_t &value) {
+    if constexpr (Config::endianness == bincode_endianness::big) {
+        write_fixed(value.high);
+        write_fixed(value.low);
+    } else {
+        Parent::serialize_u128(value);
+    }
 }
 
-inline void BincodeSerializer::serialize_len(size_t value) {
+template <class Output, class Config>
+void BasicBincodeSerializer<Output, Config>::serialize_f32(float value) {
+    write_fixed(*reinterpret_cast<uint32_t *>(&value));
+}
+
+template <class Output, class Config>
+void BasicBincodeSerializer<Output, Config>::serialize_f64(double value) {
+    write_fixed(*reinterpret_cast<uint64_t *>(&value));
+}
+
+template <class Output, class Config>
+void BasicBincodeSerializer<Output, Config>::serialize_len(size_t value) {
     if (value > BINCODE_MAX_LENGTH) {
-        throw serde::serialization_error("Length is too large");
+        SERDE_THROW(serde::serialization_error("Length is too large"));
+    }
+    serialize_u64((uint64_t)value);
+}
+
+template <class Output, class Config>
+void BasicBincodeSerializer<Output, Config>::serialize_variant_index(
+    uint32_t value) {
+    serialize_u32(value);
+}
+
+template <class Output, class Config>
+void BasicBincodeSerializer<Output, Config>::serialize_u16(uint16_t value) {
+    if constexpr (varint) {
+        write_varint(value);
+    } else {
+        write_fixed(value);
+    }
+}
+
+template <class Output, class Config>
+void BasicBincodeSerializer<Output, Config>::serialize_u32(uint32_t value) {
+    if constexpr (varint) {
+        write_varint(value);
+    } else {
+        write_fixed(value);
+    }
+}
+
+template <class Output, class Config>
+void BasicBincodeSerializer<Output, Config>::serialize_u64(uint64_t value) {
+    if constexpr (varint) {
+        write_varint(value);
+    } else {
+        write_fixed(value);
+    }
+}
+
+template <class Output, class Config>
+void BasicBincodeSerializer<Output, Config>::serialize_u128(
+    const uint128_t &value) {
+    if constexpr (varint) {
+        if (value.high == 0) {
+            write_varint(value.low);
+            return;
+        }
+        Parent::serialize_u8(BINCODE_VARINT_U128_TAG);
     }
-    Parent::serialize_u64((uint64_t)value);
+    write_fixed_u128(value);
 }
 
-inline void BincodeSerializer::serialize_variant_index(uint32_t value) {
-    Parent::serialize_u32((uint32_t)value);
+template <class Output, class Config>
+void BasicBincodeSerializer<Output, Config>::serialize_i16(int16_t value) {
+    if constexpr (varint) {
+        write_varint(zigzag_encode(value));
+    } else {
+        write_fixed((uint16_t)value);
+    }
+}
+
+template <class Output, class Config>
+void BasicBincodeSerializer<Output, Config>::serialize_i32(int32_t value) {
+    if constexpr (varint) {
+        write_varint(zigzag_encode(value));
+    } else {
+        write_fixed((uint32_t)value);
+    }
+}
+
+template <class Output, class Config>
+void BasicBincodeSerializer<Output, Config>::serialize_i64(int64_t value) {
+    if constexpr (varint) {
+        write_varint(zigzag_encode(value));
+    } else {
+        write_fixed((uint64_t)value);
+    }
+}
+
+template <class Output, class Config>
+void BasicBincodeSerializer<Output, Config>::serialize_i128(
+    const int128_t &value) {
+    auto bits = uint128_t{(uint64_t)value.high, value.low};
+    if constexpr (varint) {
+        // 128-bit zigzag encoding.
+        uint64_t sign = (uint64_t)(value.high >> 63);
+        bits = {((bits.high << 1) | (bits.low >> 63)) ^ sign,
+                (bits.low << 1) ^ sign};
+    }
+    serialize_u128(bits);
+}
+
+template <class Config>
+template <typename T>
+T BasicBincodeDeserializer<Config>::read_fixed() {
+    if constexpr (Config::endianness == bincode_endianness::big) {
+        auto bytes = Parent::read_bytes(sizeof(T));
+        return bytes != nullptr ? load_be<T>(bytes) : 0;
+    } else {
+        return Parent::template read_le<T>();
+    }
+}
+
+template <class Config>
+uint64_t BasicBincodeDeserializer<Config>::finish_varint(uint8_t tag) {
+    if (tag <= BINCODE_VARINT_MAX_SINGLE_BYTE) {
+        return tag;
+    }
+    switch (tag) {
+    case BINCODE_VARINT_U16_TAG:
+        return read_fixed<uint16_t>();
+    case BINCODE_VARINT_U32_TAG:
+        return read_fixed<uint32_t>();
+    case BINCODE_VARINT_U64_TAG:
+        return read_fixed<uint64_t>();
+    case BINCODE_VARINT_U128_TAG:
+        Parent::fail(deserialization_errc::varint_overflow);
+        return 0;
+    default:
+        Parent::fail(deserialization_errc::invalid_varint);
+        return 0;
+    }
+}
+
+template <class Config>
+uint64_t BasicBincodeDeserializer<Config>::read_varint_at_most(uint64_t max) {
+    auto value = read_varint();
+    if (value > max) {
+        Parent::fail(deserialization_errc::varint_overflow);
+        return 0;
+    }
+    return value;
+}
+
+template <class Config>
+int64_t BasicBincodeDeserializer<Config>::read_zigzag(int64_t min,
+                                                      int64_t max) {
+    auto value = zigzag_decode(read_varint());
+    if (value < min || value > max) {
+        Parent::fail(deserialization_errc::varint_overflow);
+        return 0;
+    }
+    return value;
+}
+
+template <class Config>
+uint128_t BasicBincodeDeserializer<Config>::read_fixed_u128() {
+    if constexpr (Config::endianness == bincode_endianness::big) {
+        auto bytes = Parent::read_bytes(16);
+        if (bytes == nullptr) {
+            return {0, 0};
+        }
+        return {load_be<uint64_t>(bytes), load_be<uint64_t>(bytes + 8)};
+    } else {
+        return Parent::deserialize_u128();
+    }
 }
 
-inline float BincodeDeserializer::deserialize_f32() {
-    auto value = Parent::deserialize_u32();
+template <class Config>
+float BasicBincodeDeserializer<Config>::deserialize_f32() {
+    auto value = read_fixed<uint32_t>();
     return *reinterpret_cast<float *>(&value);
 }
 
-inline double BincodeDeserializer::deserialize_f64() {
-    auto value = Parent::deserialize_u64();
+template <class Config>
+double BasicBincodeDeserializer<Config>::deserialize_f64() {
+    auto value = read_fixed<uint64_t>();
     return *reinterpret_cast<double *>(&value);
 }
 
-inline size_t BincodeDeserializer::deserialize_len() {
-    auto value = (size_t)Parent::deserialize_u64();
+template <class Config>
+size_t BasicBincodeDeserializer<Config>::deserialize_len() {
+    auto value = deserialize_u64();
     if (value > BINCODE_MAX_LENGTH) {
-        throw serde::deserialization_error("Length is too large");
+        Parent::fail(deserialization_errc::length_too_large);
+        return 0;
     }
     return (size_t)value;
 }
 
-inline uint32_t BincodeDeserializer::deserialize_variant_index() {
-    return Parent::deserialize_u32();
+template <class Config>
+uint32_t BasicBincodeDeserializer<Config>::deserialize_variant_index() {
+    return deserialize_u32();
+}
+
+template <class Config>
+uint16_t BasicBincodeDeserializer<Config>::deserialize_u16() {
+    if constexpr (varint) {
+        return (uint16_t)read_varint_at_most(UINT16_MAX);
+    } else {
+        return read_fixed<uint16_t>();
+    }
+}
+
+template <class Config>
+uint32_t BasicBincodeDeserializer<Config>::deserialize_u32() {
+    if constexpr (varint) {
+        return (uint32_t)read_varint_at_most(UINT32_MAX);
+    } else {
+        return read_fixed<uint32_t>();
+    }
+}
+
+template <class Config>
+uint64_t BasicBincodeDeserializer<Config>::deserialize_u64() {
+    if constexpr (varint) {
+        return read_varint();
+    } else {
+        return read_fixed<uint64_t>();
+    }
+}
+
+template <class Config>
+uint128_t BasicBincodeDeserializer<Config>::deserialize_u128() {
+    if constexpr (varint) {
+        auto tag = Parent::read_byte();
+        if (tag == BINCODE_VARINT_U128_TAG) {
+            return read_fixed_u128();
+        }
+        return {0, finish_varint(tag)};
+    } else {
+        return read_fixed_u128();
+    }
+}
+
+template <class Config>
+int16_t BasicBincodeDeserializer<Config>::deserialize_i16() {
+    if constexpr (varint) {
+        return (int16_t)read_zigzag(INT16_MIN, INT16_MAX);
+    } else {
+        return (int16_t)read_fixed<uint16_t>();
+    }
+}
+
+template <class Config>
+int32_t BasicBincodeDeserializer<Config>::deserialize_i32() {
+    if constexpr (varint) {
+        return (int32_t)read_zigzag(INT32_MIN, INT32_MAX);
+    } else {
+        return (int32_t)read_fixed<uint32_t>();
+    }
+}
+
+template <class Config>
+int64_t BasicBincodeDeserializer<Config>::deserialize_i64() {
+    if constexpr (varint) {
+        return zigzag_decode(read_varint());
+    } else {
+        return (int64_t)read_fixed<uint64_t>();
+    }
+}
+
+template <class Config>
+int128_t BasicBincodeDeserializer<Config>::deserialize_i128() {
+    auto bits = deserialize_u128();
+    if constexpr (varint) {
+        // 128-bit zigzag decoding.
+        uint64_t sign = 0 - (bits.low & 1);
+        bits = {(bits.high >> 1) ^ sign,
+                ((bits.low >> 1) | (bits.high << 63)) ^ sign};
+    }
+    return {(int64_t)bits.high, bits.low};
 }
 
 } // end of namespace serde
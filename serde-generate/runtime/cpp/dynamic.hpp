@@ -0,0 +1,941 @@
+// Copyright (c) Facebook, Inc. and its affiliates
+// SPDX-License-Identifier: MIT OR Apache-2.0
+
+#pragma once
+
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "binary.hpp"
+#include "serde.hpp"
+
+// Schema-driven codecs. A registry of formats loaded at runtime (see
+// serde-reflection/src/format.rs) is compiled into compact plans that
+// validate, skip, re-encode and search encoded values without generated code.
+// Registries are read from their binary encoding, e.g.
+// `bcs::to_bytes(&registry)` in Rust.
+
+namespace serde {
+namespace dynamic {
+
+// --- Formats ---
+
+// Formats of serde-reflection, numbered by their variant indices. The variant
+// 0 (`Variable`) only exists while tracing.
+enum class FormatKind : uint32_t {
+    TypeName = 1,
+    Unit,
+    Bool,
+    I8,
+    I16,
+    I32,
+    I64,
+    I128,
+    U8,
+    U16,
+    U32,
+    U64,
+    U128,
+    F32,
+    F64,
+    Char,
+    Str,
+    Bytes,
+    Option,
+    Seq,
+    Map,
+    Tuple,
+    TupleArray,
+};
+
+struct Format {
+    FormatKind kind = FormatKind::Unit;
+    // Name of the container (`TypeName`).
+    std::string name;
+    // Nested formats: the content of options, sequences and arrays, the key
+    // then the value of maps, or the elements of tuples.
+    std::vector<Format> formats;
+    // Number of elements (`TupleArray`).
+    size_t size = 0;
+};
+
+// Field of a struct or of a variant. Fields of tuples have no names.
+struct Field {
+    std::string name;
+    Format format;
+};
+
+struct Variant {
+    std::string name;
+    std::vector<Field> fields;
+};
+
+// Containers, numbered by the variant indices of `ContainerFormat`.
+enum class ContainerKind : uint32_t {
+    UnitStruct = 0,
+    NewTypeStruct,
+    TupleStruct,
+    Struct,
+    Enum,
+};
+
+struct ContainerFormat {
+    ContainerKind kind = ContainerKind::UnitStruct;
+    // Fields of structs.
+    std::vector<Field> fields;
+    // Variants of enums, by index.
+    std::map<uint32_t, Variant> variants;
+};
+
+using Registry = std::map<std::string, ContainerFormat>;
+
+} // end of namespace dynamic
+
+// --- Decoding of registries ---
+
+template <>
+struct Deserializable<dynamic::Format> {
+    template <typename Deserializer>
+    static dynamic::Format deserialize(Deserializer &deserializer) {
+        using dynamic::FormatKind;
+        dynamic::Format format;
+        deserializer.increase_container_depth();
+        auto index = deserializer.deserialize_variant_index();
+        if (index < (uint32_t)FormatKind::TypeName ||
+            index > (uint32_t)FormatKind::TupleArray) {
+            deserializer.fail(deserialization_errc::unknown_variant_index);
+            index = (uint32_t)FormatKind::Unit;
+        }
+        format.kind = (FormatKind)index;
+        switch (format.kind) {
+        case FormatKind::TypeName:
+            format.name = deserializer.deserialize_str();
+            break;
+        case FormatKind::Option:
+        case FormatKind::Seq:
+            format.formats.push_back(deserialize(deserializer));
+            break;
+        case FormatKind::Map:
+            format.formats.push_back(deserialize(deserializer));
+            format.formats.push_back(deserialize(deserializer));
+            break;
+        case FormatKind::Tuple:
+            format.formats =
+                Deserializable<std::vector<dynamic::Format>>::deserialize(
+                    deserializer);
+            break;
+        case FormatKind::TupleArray:
+            format.formats.push_back(deserialize(deserializer));
+            format.size = (size_t)deserializer.deserialize_u64();
+            break;
+        default:
+            break;
+        }
+        deserializer.decrease_container_depth();
+        return format;
+    }
+};
+
+template <>
+struct Deserializable<dynamic::Field> {
+    template <typename Deserializer>
+    static dynamic::Field deserialize(Deserializer &deserializer) {
+        dynamic::Field field;
+        field.name = deserializer.deserialize_str();
+        field.format =
+            Deserializable<dynamic::Format>::deserialize(deserializer);
+        return field;
+    }
+};
+
+namespace dynamic {
+
+// Fields of tuples and of new-type containers.
+template <typename Deserializer>
+std::vector<Field> deserialize_unnamed_fields(Deserializer &deserializer,
+                                              bool is_new_type) {
+    std::vector<Format> formats;
+    if (is_new_type) {
+        formats.push_back(Deserializable<Format>::deserialize(deserializer));
+    } else {
+        formats =
+            Deserializable<std::vector<Format>>::deserialize(deserializer);
+    }
+    std::vector<Field> fields;
+    for (auto &format : formats) {
+        fields.push_back({"", std::move(format)});
+    }
+    return fields;
+}
+
+} // end of namespace dynamic
+
+template <>
+struct Deserializable<dynamic::Variant> {
+    template <typename Deserializer>
+    static dynamic::Variant deserialize(Deserializer &deserializer) {
+        dynamic::Variant variant;
+        variant.name = deserializer.deserialize_str();
+        deserializer.increase_container_depth();
+        // Variant indices of `VariantFormat`: 1 for unit variants, then
+        // new-type, tuple and struct variants.
+        auto index = deserializer.deserialize_variant_index();
+        switch (index) {
+        case 1:
+            break;
+        case 2:
+        case 3:
+            variant.fields =
+                dynamic::deserialize_unnamed_fields(deserializer, index == 2);
+            break;
+        case 4:
+            variant.fields =
+                Deserializable<std::vector<dynamic::Field>>::deserialize(
+                    deserializer);
+            break;
+        default:
+            deserializer.fail(deserialization_errc::unknown_variant_index);
+            break;
+        }
+        deserializer.decrease_container_depth();
+        return variant;
+    }
+};
+
+template <>
+struct Deserializable<dynamic::ContainerFormat> {
+    template <typename Deserializer>
+    static dynamic::ContainerFormat deserialize(Deserializer &deserializer) {
+        using dynamic::ContainerKind;
+        dynamic::ContainerFormat format;
+        deserializer.increase_container_depth();
+        auto index = deserializer.deserialize_variant_index();
+        if (index > (uint32_t)ContainerKind::Enum) {
+            deserializer.fail(deserialization_errc::unknown_variant_index);
+            index = (uint32_t)ContainerKind::UnitStruct;
+        }
+        format.kind = (ContainerKind)index;
+        switch (format.kind) {
+        case ContainerKind::UnitStruct:
+            break;
+        case ContainerKind::NewTypeStruct:
+        case ContainerKind::TupleStruct:
+            format.fields = dynamic::deserialize_unnamed_fields(
+                deserializer, format.kind == ContainerKind::NewTypeStruct);
+            break;
+        case ContainerKind::Struct:
+            format.fields =
+                Deserializable<std::vector<dynamic::Field>>::deserialize(
+                    deserializer);
+            break;
+        case ContainerKind::Enum:
+            format.variants =
+                Deserializable<std::map<uint32_t, dynamic::Variant>>::
+                    deserialize(deserializer);
+            break;
+        }
+        deserializer.decrease_container_depth();
+        return format;
+    }
+};
+
+namespace dynamic {
+
+// Decode a registry, e.g. with `deserialize_registry<BcsDeserializer>`.
+template <typename Deserializer>
+Registry deserialize_registry(const uint8_t *input, size_t size) {
+    auto deserializer = Deserializer(input, size);
+    auto registry = Deserializable<Registry>::deserialize(deserializer);
+    if (deserializer.get_buffer_offset() < size) {
+        SERDE_THROW(deserialization_error("Some input bytes were not read"));
+    }
+    return registry;
+}
+
+// --- Compiled plans ---
+
+enum class Opcode : uint8_t {
+    // `size` bytes copied as they are, e.g. fixed-width integers.
+    Fixed,
+    Bool,
+    F32,
+    F64,
+    Char,
+    Str,
+    Bytes,
+    // Content in `first`.
+    Option,
+    // Elements in `first`, each made of `size` fixed bytes if `size > 0`.
+    Seq,
+    // `size` elements in `first`.
+    Array,
+    // Keys in `first` and values in `second`.
+    Map,
+    // The container of index `size`.
+    Container,
+};
+
+// Range of instructions.
+struct Block {
+    uint32_t begin = 0;
+    uint32_t end = 0;
+};
+
+struct Instruction {
+    Opcode opcode;
+    size_t size;
+    Block first;
+    Block second;
+
+    Instruction(Opcode opcode, size_t size = 0, Block first = {},
+                Block second = {})
+        : opcode(opcode), size(size), first(first), second(second) {}
+};
+
+// Plan of a struct, or of a variant of an enum.
+struct Shape {
+    std::string name;
+    std::vector<std::string> field_names;
+    // Each field on its own, for field lookups.
+    std::vector<Block> fields;
+    // All the fields, with adjacent fixed-size fields merged.
+    Block body;
+};
+
+struct ContainerPlan {
+    std::string name;
+    bool is_enum = false;
+    // A single shape for structs, the variants by index for enums.
+    std::vector<Shape> shapes;
+};
+
+// Compiled lookup of a field nested in a value (see `Codec::find`).
+struct FieldPath {
+    struct Step {
+        uint32_t container;
+        // Expected variant when the container is an enum.
+        uint32_t variant;
+        // Fields before the selected one, merged, then the selected field.
+        Block prefix;
+        Block field;
+    };
+
+    uint32_t type;
+    std::vector<Step> steps;
+};
+
+// Bytes of a value inside its input.
+struct Slice {
+    const uint8_t *data;
+    size_t size;
+};
+
+// Codec of the containers of a registry. The plan of a container is compiled
+// with its dependencies on first use, then cached under its name. Plans merge
+// fixed-width values, so they only apply to encodings with
+// `fixed_width_integers` (BCS and the fixint configurations of Bincode).
+//
+// Plans never change once compiled, so that the const methods may be called
+// concurrently. Compiling (`type_index`, `field_path`) must not run
+// concurrently with other calls.
+class Codec {
+    Registry registry_;
+    std::vector<Instruction> code_;
+    std::vector<ContainerPlan> containers_;
+    std::unordered_map<std::string, uint32_t> indices_;
+
+  public:
+    // The registry is checked once here: names must be defined and variant
+    // indices must be consecutive. Throws `std::invalid_argument` otherwise.
+    explicit Codec(Registry registry);
+
+    // Index of the compiled plan of the container `name`.
+    uint32_t type_index(const std::string &name);
+
+    // Compile the lookup of a field given by the names of the fields and
+    // variants leading to it, e.g. {"Transfer", "amount"} in an enum with a
+    // variant `Transfer { amount: u64 }`. Unnamed fields are given by their
+    // position, e.g. "0".
+    FieldPath field_path(const std::string &name,
+                         const std::vector<std::string> &path);
+
+    // Consume the encoding of a value of the given type. Like
+    // `Skippable<T>::skip`, this accepts exactly the inputs that generated
+    // code would deserialize, without allocating.
+    template <typename Deserializer>
+    void skip(uint32_t type, Deserializer &deserializer) const {
+        skip_container(type, deserializer);
+    }
+
+    // Check that an input starts with the encoding of a value of the given
+    // type, and return its size.
+    template <typename Deserializer>
+    size_t validate(uint32_t type, const uint8_t *input, size_t size) const {
+        auto deserializer = Deserializer(input, size);
+        skip(type, deserializer);
+        return deserializer.get_buffer_offset();
+    }
+
+    // Decode a value with `deserializer` and encode it again with
+    // `serializer`, e.g. to convert from Bincode to BCS. Fixed-width
+    // integers are copied as they are, so both encodings must use the same
+    // byte order.
+    template <typename Deserializer, typename Serializer>
+    void transcode(uint32_t type, Deserializer &deserializer,
+                   Serializer &serializer) const {
+        transcode_container(type, deserializer, serializer);
+    }
+
+    // The bytes of the field selected by `path`, or nothing if a variant on
+    // the path does not match the input. Only the input up to the end of the
+    // field is read and checked.
+    template <typename Deserializer>
+    std::optional<Slice> find(const FieldPath &path, const uint8_t *input,
+                              size_t size) const;
+
+    const Registry &registry() const { return registry_; }
+
+  private:
+    void check_format(const Format &format) const;
+    Shape compile_shape(const std::string &name,
+                        const std::vector<Field> &fields);
+    void compile_format(const Format &format,
+                        std::vector<Instruction> &block);
+    Block append_block(const std::vector<Instruction> &block);
+    static void append_instruction(std::vector<Instruction> &block,
+                                   Instruction instruction);
+    // Size of the values of a block made of fixed bytes only, or 0.
+    size_t fixed_size(Block block) const;
+
+    template <typename Deserializer>
+    void skip_container(uint32_t index, Deserializer &deserializer) const;
+    template <typename Deserializer>
+    void skip_block(Block block, Deserializer &deserializer) const;
+    template <typename Deserializer, typename Serializer>
+    void transcode_container(uint32_t index, Deserializer &deserializer,
+                             Serializer &serializer) const;
+    template <typename Deserializer, typename Serializer>
+    void transcode_block(Block block, Deserializer &deserializer,
+                         Serializer &serializer) const;
+};
+
+inline Codec::Codec(Registry registry) : registry_(std::move(registry)) {
+    for (const auto &[name, container] : registry_) {
+        for (const auto &field : container.fields) {
+            check_format(field.format);
+        }
+        uint32_t expected_index = 0;
+        for (const auto &[index, variant] : container.variants) {
+            if (index != expected_index++) {
+                SERDE_THROW(std::invalid_argument(
+                    "Variant indices are not consecutive in " + name));
+            }
+            for (const auto &field : variant.fields) {
+                check_format(field.format);
+            }
+        }
+    }
+}
+
+inline void Codec::check_format(const Format &format) const {
+    if (format.kind == FormatKind::TypeName &&
+        registry_.find(format.name) == registry_.end()) {
+        SERDE_THROW(std::invalid_argument("Unknown container " + format.name));
+    }
+    for (const auto &nested : format.formats) {
+        check_format(nested);
+    }
+}
+
+inline uint32_t Codec::type_index(const std::string &name) {
+    auto cached = indices_.find(name);
+    if (cached != indices_.end()) {
+        return cached->second;
+    }
+    auto entry = registry_.find(name);
+    if (entry == registry_.end()) {
+        SERDE_THROW(std::invalid_argument("Unknown container " + name));
+    }
+    // Register the container first, so that recursive references to it are
+    // compiled to its index.
+    auto index = (uint32_t)containers_.size();
+    indices_.emplace(name, index);
+    containers_.emplace_back();
+    ContainerPlan plan;
+    plan.name = name;
+    const auto &container = entry->second;
+    if (container.kind == ContainerKind::Enum) {
+        plan.is_enum = true;
+        for (const auto &[variant_index, variant] : container.variants) {
+            plan.shapes.push_back(compile_shape(variant.name, variant.fields));
+        }
+    } else {
+        plan.shapes.push_back(compile_shape(name, container.fields));
+    }
+    containers_[index] = std::move(plan);
+    return index;
+}
+
+inline Shape Codec::compile_shape(const std::string &name,
+                                  const std::vector<Field> &fields) {
+    Shape shape;
+    shape.name = name;
+    std::vector<Instruction> body;
+    for (const auto &field : fields) {
+        std::vector<Instruction> block;
+        compile_format(field.format, block);
+        for (const auto &instruction : block) {
+            append_instruction(body, instruction);
+        }
+        shape.field_names.push_back(field.name);
+        shape.fields.push_back(append_block(block));
+    }
+    shape.body = append_block(body);
+    return shape;
+}
+
+inline void Codec::compile_format(const Format &format,
+                                  std::vector<Instruction> &block) {
+    auto fixed = [&](size_t size) {
+        append_instruction(block, {Opcode::Fixed, size});
+    };
+    auto nested = [&](const Format &format) {
+        std::vector<Instruction> nested_block;
+        compile_format(format, nested_block);
+        return append_block(nested_block);
+    };
+    switch (format.kind) {
+    case FormatKind::TypeName:
+        block.push_back({Opcode::Container, type_index(format.name)});
+        break;
+    case FormatKind::Unit:
+        break;
+    case FormatKind::Bool:
+        block.push_back({Opcode::Bool});
+        break;
+    case FormatKind::I8:
+    case FormatKind::U8:
+        fixed(1);
+        break;
+    case FormatKind::I16:
+    case FormatKind::U16:
+        fixed(2);
+        break;
+    case FormatKind::I32:
+    case FormatKind::U32:
+        fixed(4);
+        break;
+    case FormatKind::I64:
+    case FormatKind::U64:
+        fixed(8);
+        break;
+    case FormatKind::I128:
+    case FormatKind::U128:
+        fixed(16);
+        break;
+    case FormatKind::F32:
+        block.push_back({Opcode::F32});
+        break;
+    case FormatKind::F64:
+        block.push_back({Opcode::F64});
+        break;
+    case FormatKind::Char:
+        block.push_back({Opcode::Char});
+        break;
+    case FormatKind::Str:
+        block.push_back({Opcode::Str});
+        break;
+    case FormatKind::Bytes:
+        block.push_back({Opcode::Bytes});
+        break;
+    case FormatKind::Option:
+        block.push_back({Opcode::Option, 0, nested(format.formats[0])});
+        break;
+    case FormatKind::Seq: {
+        auto content = nested(format.formats[0]);
+        block.push_back({Opcode::Seq, fixed_size(content), content});
+        break;
+    }
+    case FormatKind::Map: {
+        auto key = nested(format.formats[0]);
+        auto value = nested(format.formats[1]);
+        block.push_back({Opcode::Map, 0, key, value});
+        break;
+    }
+    case FormatKind::Tuple:
+        for (const auto &element : format.formats) {
+            compile_format(element, block);
+        }
+        break;
+    case FormatKind::TupleArray: {
+        auto content = nested(format.formats[0]);
+        if (content.begin == content.end) {
+            break;
+        }
+        if (auto size = fixed_size(content)) {
+            fixed(size * format.size);
+        } else {
+            block.push_back({Opcode::Array, format.size, content});
+        }
+        break;
+    }
+    }
+}
+
+inline Block Codec::append_block(const std::vector<Instruction> &block) {
+    Block result{(uint32_t)code_.size(), 0};
+    code_.insert(code_.end(), block.begin(), block.end());
+    result.end = (uint32_t)code_.size();
+    return result;
+}
+
+inline void Codec::append_instruction(std::vector<Instruction> &block,
+                                      Instruction instruction) {
+    if (instruction.opcode == Opcode::Fixed && !block.empty() &&
+        block.back().opcode == Opcode::Fixed) {
+        block.back().size += instruction.size;
+    } else {
+        block.push_back(instruction);
+    }
+}
+
+inline size_t Codec::fixed_size(Block block) const {
+    if (block.end == block.begin + 1 &&
+        code_[block.begin].opcode == Opcode::Fixed) {
+        return code_[block.begin].size;
+    }
+    return 0;
+}
+
+inline FieldPath Codec::field_path(const std::string &name,
+                                   const std::vector<std::string> &path) {
+    FieldPath result;
+    result.type = type_index(name);
+    uint32_t container = result.type;
+    auto invalid_path = [&]([[maybe_unused]] const std::string &reason) {
+        SERDE_THROW(std::invalid_argument(reason + " in the path of " + name));
+    };
+    size_t i = 0;
+    while (i < path.size()) {
+        const auto &plan = containers_[container];
+        uint32_t variant = 0;
+        if (plan.is_enum) {
+            while (variant < plan.shapes.size() &&
+                   plan.shapes[variant].name != path[i]) {
+                variant++;
+            }
+            if (variant == plan.shapes.size()) {
+                invalid_path("Unknown variant " + path[i]);
+            }
+            if (++i == path.size()) {
+                invalid_path("Missing field after variant " + path[i - 1]);
+            }
+        }
+        const auto &shape = plan.shapes[variant];
+        uint32_t field = 0;
+        while (field < shape.fields.size() &&
+               shape.field_names[field] != path[i] &&
+               !(shape.field_names[field].empty() &&
+                 std::to_string(field) == path[i])) {
+            field++;
+        }
+        if (field == shape.fields.size()) {
+            invalid_path("Unknown field " + path[i]);
+        }
+        std::vector<Instruction> prefix;
+        for (uint32_t j = 0; j < field; j++) {
+            auto block = shape.fields[j];
+            for (auto k = block.begin; k < block.end; k++) {
+                append_instruction(prefix, code_[k]);
+            }
+        }
+        auto block = shape.fields[field];
+        result.steps.push_back(
+            {container, variant, append_block(prefix), block});
+        if (++i < path.size()) {
+            if (block.end != block.begin + 1 ||
+                code_[block.begin].opcode != Opcode::Container) {
+                invalid_path("Field " + path[i - 1] + " is not a container");
+            }
+            container = (uint32_t)code_[block.begin].size;
+        }
+    }
+    return result;
+}
+
+template <typename Deserializer>
+std::optional<Slice> Codec::find(const FieldPath &path, const uint8_t *input,
+                                 size_t size) const {
+    auto deserializer = Deserializer(input, size);
+    if (path.steps.empty()) {
+        skip_container(path.type, deserializer);
+        return Slice{input, deserializer.get_buffer_offset()};
+    }
+    for (const auto &step : path.steps) {
+        const auto &plan = containers_[step.container];
+        deserializer.increase_container_depth();
+        if (plan.is_enum) {
+            auto variant = deserializer.deserialize_variant_index();
+            if (variant >= plan.shapes.size()) {
+                deserializer.fail(deserialization_errc::unknown_variant_index);
+            }
+            if (variant != step.variant || deserializer.has_failed()) {
+                return {};
+            }
+        }
+        skip_block(step.prefix, deserializer);
+    }
+    auto start = deserializer.get_buffer_offset();
+    skip_block(path.steps.back().field, deserializer);
+    if (deserializer.has_failed()) {
+        return {};
+    }
+    return Slice{input + start, deserializer.get_buffer_offset() - start};
+}
+
+template <typename Deserializer>
+void Codec::skip_container(uint32_t index, Deserializer &deserializer) const {
+    const auto &plan = containers_[index];
+    deserializer.increase_container_depth();
+    if (plan.is_enum) {
+        auto variant = deserializer.deserialize_variant_index();
+        if (variant >= plan.shapes.size()) {
+            deserializer.fail(deserialization_errc::unknown_variant_index);
+        } else {
+            skip_block(plan.shapes[variant].body, deserializer);
+        }
+    } else {
+        skip_block(plan.shapes[0].body, deserializer);
+    }
+    deserializer.decrease_container_depth();
+}
+
+template <typename Deserializer>
+void Codec::skip_block(Block block, Deserializer &deserializer) const {
+    static_assert(Deserializer::fixed_width_integers,
+                  "plans expect fixed-width integers");
+    for (auto i = block.begin; i < block.end; i++) {
+        const auto &instruction = code_[i];
+        switch (instruction.opcode) {
+        case Opcode::Fixed:
+            deserializer.deserialize_raw_bytes(instruction.size);
+            break;
+        case Opcode::Bool:
+            deserializer.deserialize_bool();
+            break;
+        case Opcode::F32:
+            deserializer.deserialize_f32();
+            break;
+        case Opcode::F64:
+            deserializer.deserialize_f64();
+            break;
+        case Opcode::Char:
+            deserializer.deserialize_char();
+            break;
+        case Opcode::Str:
+            deserializer.skip_str();
+            break;
+        case Opcode::Bytes:
+            deserializer.deserialize_raw_bytes(deserializer.deserialize_len());
+            break;
+        case Opcode::Option:
+            if (deserializer.deserialize_option_tag()) {
+                skip_block(instruction.first, deserializer);
+            }
+            break;
+        case Opcode::Seq: {
+            size_t len = deserializer.deserialize_len();
+            if (instruction.size > 0) {
+                if (len > SIZE_MAX / instruction.size) {
+                    deserializer.fail(deserialization_errc::length_too_large);
+                    break;
+                }
+                deserializer.deserialize_raw_bytes(len * instruction.size);
+                break;
+            }
+            for (size_t j = 0; j < len && !deserializer.has_failed(); j++) {
+                skip_block(instruction.first, deserializer);
+            }
+            break;
+        }
+        case Opcode::Array:
+            for (size_t j = 0;
+                 j < instruction.size && !deserializer.has_failed(); j++) {
+                skip_block(instruction.first, deserializer);
+            }
+            break;
+        case Opcode::Map: {
+            size_t len = deserializer.deserialize_len();
+            std::optional<std::tuple<size_t, size_t>> previous_key_slice;
+            if constexpr (Deserializer::enforce_strict_map_ordering) {
+                deserializer.begin_map_entries();
+            }
+            for (size_t j = 0; j < len && !deserializer.has_failed(); j++) {
+                auto start = deserializer.get_buffer_offset();
+                skip_block(instruction.first, deserializer);
+                check_map_key(deserializer, previous_key_slice, start);
+                skip_block(instruction.second, deserializer);
+            }
+            if constexpr (Deserializer::enforce_strict_map_ordering) {
+                deserializer.end_map_entries();
+            }
+            break;
+        }
+        case Opcode::Container:
+            if (!deserializer.has_failed()) {
+                skip_container((uint32_t)instruction.size, deserializer);
+            }
+            break;
+        }
+    }
+}
+
+template <typename Deserializer, typename Serializer>
+void Codec::transcode_container(uint32_t index, Deserializer &deserializer,
+                                Serializer &serializer) const {
+    const auto &plan = containers_[index];
+    deserializer.increase_container_depth();
+    serializer.increase_container_depth();
+    if (plan.is_enum) {
+        auto variant = deserializer.deserialize_variant_index();
+        if (variant >= plan.shapes.size()) {
+            deserializer.fail(deserialization_errc::unknown_variant_index);
+        } else {
+            serializer.serialize_variant_index(variant);
+            transcode_block(plan.shapes[variant].body, deserializer,
+                            serializer);
+        }
+    } else {
+        transcode_block(plan.shapes[0].body, deserializer, serializer);
+    }
+    serializer.decrease_container_depth();
+    deserializer.decrease_container_depth();
+}
+
+// After an error, the output is unspecified and must be discarded.
+template <typename Deserializer, typename Serializer>
+void Codec::transcode_block(Block block, Deserializer &deserializer,
+                            Serializer &serializer) const {
+    static_assert(Deserializer::fixed_width_integers &&
+                      Serializer::fixed_width_integers,
+                  "plans expect fixed-width integers");
+    static_assert(Deserializer::little_endian_integers ==
+                      Serializer::little_endian_integers,
+                  "fixed-width values are copied without conversion");
+    auto copy_bytes = [&](size_t len) {
+        if (auto bytes = deserializer.deserialize_raw_bytes(len)) {
+            serializer.serialize_raw_bytes(bytes, len);
+        }
+    };
+    for (auto i = block.begin; i < block.end; i++) {
+        const auto &instruction = code_[i];
+        switch (instruction.opcode) {
+        case Opcode::Fixed:
+            copy_bytes(instruction.size);
+            break;
+        case Opcode::Bool:
+            serializer.serialize_bool(deserializer.deserialize_bool());
+            break;
+        case Opcode::F32:
+            serializer.serialize_f32(deserializer.deserialize_f32());
+            break;
+        case Opcode::F64:
+            serializer.serialize_f64(deserializer.deserialize_f64());
+            break;
+        case Opcode::Char:
+            serializer.serialize_char(deserializer.deserialize_char());
+            break;
+        case Opcode::Str: {
+            size_t len = deserializer.deserialize_len();
+            serializer.serialize_len(len);
+            if (auto bytes = deserializer.deserialize_raw_bytes(len)) {
+                if (!is_valid_utf8(bytes, len)) {
+                    deserializer.fail(deserialization_errc::invalid_utf8);
+                    break;
+                }
+                serializer.serialize_raw_bytes(bytes, len);
+            }
+            break;
+        }
+        case Opcode::Bytes: {
+            size_t len = deserializer.deserialize_len();
+            serializer.serialize_len(len);
+            copy_bytes(len);
+            break;
+        }
+        case Opcode::Option: {
+            bool tag = deserializer.deserialize_option_tag();
+            serializer.serialize_option_tag(tag);
+            if (tag) {
+                transcode_block(instruction.first, deserializer, serializer);
+            }
+            break;
+        }
+        case Opcode::Seq: {
+            size_t len = deserializer.deserialize_len();
+            serializer.serialize_len(len);
+            if (instruction.size > 0) {
+                if (len > SIZE_MAX / instruction.size) {
+                    deserializer.fail(deserialization_errc::length_too_large);
+                    break;
+                }
+                copy_bytes(len * instruction.size);
+                break;
+            }
+            for (size_t j = 0; j < len && !deserializer.has_failed(); j++) {
+                transcode_block(instruction.first, deserializer, serializer);
+            }
+            break;
+        }
+        case Opcode::Array:
+            for (size_t j = 0;
+                 j < instruction.size && !deserializer.has_failed(); j++) {
+                transcode_block(instruction.first, deserializer, serializer);
+            }
+            break;
+        case Opcode::Map: {
+            size_t len = deserializer.deserialize_len();
+            serializer.serialize_len(len);
+            std::optional<std::tuple<size_t, size_t>> previous_key_slice;
+            std::vector<size_t> offsets;
+            if constexpr (Deserializer::enforce_strict_map_ordering) {
+                deserializer.begin_map_entries();
+            }
+            if constexpr (Serializer::enforce_strict_map_ordering) {
+                offsets.reserve(
+                    std::min(len, deserializer.get_remaining_bytes()));
+                serializer.begin_map_entries();
+            }
+            for (size_t j = 0; j < len && !deserializer.has_failed(); j++) {
+                if constexpr (Serializer::enforce_strict_map_ordering) {
+                    offsets.push_back(serializer.get_buffer_offset());
+                }
+                auto start = deserializer.get_buffer_offset();
+                transcode_block(instruction.first, deserializer, serializer);
+                check_map_key(deserializer, previous_key_slice, start);
+                transcode_block(instruction.second, deserializer, serializer);
+            }
+            if constexpr (Serializer::enforce_strict_map_ordering) {
+                serializer.sort_last_entries(offsets);
+            }
+            if constexpr (Deserializer::enforce_strict_map_ordering) {
+                deserializer.end_map_entries();
+            }
+            break;
+        }
+        case Opcode::Container:
+            if (!deserializer.has_failed()) {
+                transcode_container((uint32_t)instruction.size, deserializer,
+                                    serializer);
+            }
+            break;
+        }
+    }
+}
+
+} // end of namespace dynamic
+} // end of namespace serde
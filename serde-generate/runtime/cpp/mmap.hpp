@@ -0,0 +1,151 @@
+// Copyright (c) Facebook, Inc. and its affiliates
+// SPDX-License-Identifier: MIT OR Apache-2.0
+
+#pragma once
+
+#include <optional>
+#include <string>
+#include <system_error>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "binary.hpp"
+#include "serde.hpp"
+
+namespace serde {
+
+#if defined(__unix__) || defined(__APPLE__)
+// Read-only memory mapping of a whole file. Large inputs can then be decoded
+// in place with the borrowed-buffer constructors of the deserializers, e.g.
+// `BcsDeserializer(file.data(), file.size())`, without reading them into
+// memory first. Pages are loaded on demand by the kernel.
+class MappedFile {
+    const uint8_t *data_ = nullptr;
+    size_t size_ = 0;
+
+  public:
+    explicit MappedFile(const std::string &path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            SERDE_THROW(std::system_error(errno, std::generic_category(),
+                                          "Failed to open " + path));
+        }
+        struct stat stats;
+        if (::fstat(fd, &stats) < 0) {
+            [[maybe_unused]] int error = errno;
+            ::close(fd);
+            SERDE_THROW(std::system_error(error, std::generic_category(),
+                                          "Failed to stat " + path));
+        }
+        size_ = (size_t)stats.st_size;
+        // Empty files cannot be mapped.
+        if (size_ > 0) {
+            void *data = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED) {
+                [[maybe_unused]] int error = errno;
+                ::close(fd);
+                SERDE_THROW(std::system_error(error, std::generic_category(),
+                                              "Failed to map " + path));
+            }
+            // Inputs are decoded from front to back.
+            ::madvise(data, size_, MADV_SEQUENTIAL);
+            ::madvise(data, size_, MADV_WILLNEED);
+            data_ = static_cast<const uint8_t *>(data);
+        }
+        // The mapping stays valid after the file is closed.
+        ::close(fd);
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    MappedFile(MappedFile &&other) noexcept
+        : data_(other.data_), size_(other.size_) {
+        other.data_ = nullptr;
+        other.size_ = 0;
+    }
+
+    MappedFile &operator=(MappedFile &&other) noexcept {
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+        return *this;
+    }
+
+    ~MappedFile() {
+        if (data_ != nullptr) {
+            ::munmap(const_cast<uint8_t *>(data_), size_);
+        }
+    }
+
+    const uint8_t *data() const { return data_; }
+    size_t size() const { return size_; }
+};
+#endif
+
+// --- Record files ---
+
+// A record file is a sequence of records, each made of its length as a
+// little-endian u64 followed by the given number of bytes. Records typically
+// hold one encoded value each, so that a snapshot can be decoded one value at
+// a time.
+
+// Append a record to a sink (see `SinkOutput`).
+template <typename Sink>
+void write_record(Sink &sink, const uint8_t *bytes, size_t len) {
+    uint8_t prefix[8];
+    store_le<uint64_t>(prefix, len);
+    sink.write(prefix, sizeof(prefix));
+    sink.write(bytes, len);
+}
+
+template <typename Sink>
+void write_record(Sink &sink, const std::vector<uint8_t> &bytes) {
+    write_record(sink, bytes.data(), bytes.size());
+}
+
+// Bytes of a record. They point into the buffer of the `RecordReader`.
+struct Record {
+    const uint8_t *data;
+    size_t size;
+};
+
+// Iterates lazily over the records of a borrowed buffer, e.g. a MappedFile.
+class RecordReader {
+    const uint8_t *bytes_;
+    size_t size_;
+    size_t pos_ = 0;
+
+  public:
+    RecordReader(const uint8_t *bytes, size_t size)
+        : bytes_(bytes), size_(size) {}
+
+    // The next record, or nothing after the last one. A truncated record is
+    // a deserialization error.
+    std::optional<Record> next() {
+        if (pos_ == size_) {
+            return {};
+        }
+        if (size_ - pos_ < 8) {
+            SERDE_THROW(deserialization_error("Truncated record length"));
+        }
+        auto len = load_le<uint64_t>(bytes_ + pos_);
+        pos_ += 8;
+        if (len > size_ - pos_) {
+            SERDE_THROW(deserialization_error("Truncated record"));
+        }
+        Record record{bytes_ + pos_, (size_t)len};
+        pos_ += (size_t)len;
+        return record;
+    }
+
+    // Offset of the next record in the buffer.
+    size_t get_buffer_offset() const { return pos_; }
+};
+
+} // end of namespace serde
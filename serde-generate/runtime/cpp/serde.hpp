@@ -3,18 +3,140 @@
 
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
 #include <map>
 #include <memory>
 #include <optional>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <tuple>
 #include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <variant>
 #include <vector>
 
+#if defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#endif
+#endif
+
+// Exceptions may be disabled with `-fno-exceptions`. Deserialization errors
+// can then only be observed through error codes (see `deserialization_errc`)
+// and every other error aborts the program.
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS) || defined(_CPPUNWIND)
+#define SERDE_EXCEPTIONS 1
+#define SERDE_THROW(exception) throw exception
+#else
+#define SERDE_EXCEPTIONS 0
+#define SERDE_THROW(exception) std::abort()
+#endif
+
+// Instrumentation is disabled unless `SERDE_INSTRUMENTATION` is defined to 1
+// before including the runtime. Instrumented builds count the work done by
+// serializers and deserializers (see `Counters`) and time the generated code
+// of every type (see `set_type_timing_hook`). Otherwise, the hooks below
+// compile to nothing.
+#ifndef SERDE_INSTRUMENTATION
+#define SERDE_INSTRUMENTATION 0
+#endif
+
+#if SERDE_INSTRUMENTATION
+#include <chrono>
+
+namespace serde {
+
+// Work done by the serializers and deserializers of the current thread. Reset
+// with `thread_counters() = {}`.
+struct Counters {
+    uint64_t bytes_written = 0;
+    uint64_t bytes_read = 0;
+    // Memory blocks requested for the strings, vectors and map entries being
+    // decoded, and for value pointers.
+    uint64_t allocations = 0;
+    uint64_t strings_validated = 0;
+    // Map entries sorted by BCS serializers.
+    uint64_t map_entries_sorted = 0;
+    // Map keys checked for canonical order by BCS deserializers.
+    uint64_t map_keys_checked = 0;
+    // Maximal number of nested containers.
+    size_t max_depth = 0;
+};
+
+inline Counters &thread_counters() {
+    static thread_local Counters counters;
+    return counters;
+}
+
+// Receives the time spent by the generated code of a type to `operation`
+// ("serialize", "deserialize", "deserialize_into" or "skip") a value, nested
+// values included.
+using TypeTimingHook = void (*)(const char *type_name, const char *operation,
+                                std::chrono::nanoseconds elapsed);
+
+inline TypeTimingHook &type_timing_hook() {
+    static TypeTimingHook hook = nullptr;
+    return hook;
+}
+
+// Install the hook before serializing or deserializing values on other
+// threads. Timing is skipped while no hook is installed.
+inline void set_type_timing_hook(TypeTimingHook hook) {
+    type_timing_hook() = hook;
+}
+
+// Report the lifetime of a scope to the type timing hook.
+class TypeTimer {
+    const char *type_name_;
+    const char *operation_;
+    TypeTimingHook hook_;
+    std::chrono::steady_clock::time_point start_;
+
+  public:
+    TypeTimer(const char *type_name, const char *operation)
+        : type_name_(type_name), operation_(operation),
+          hook_(type_timing_hook()) {
+        if (hook_ != nullptr) {
+            start_ = std::chrono::steady_clock::now();
+        }
+    }
+
+    TypeTimer(const TypeTimer &) = delete;
+    TypeTimer &operator=(const TypeTimer &) = delete;
+
+    ~TypeTimer() {
+        if (hook_ != nullptr) {
+            hook_(type_name_, operation_,
+                  std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now() - start_));
+        }
+    }
+};
+
+} // end of namespace serde
+
+#define SERDE_COUNT(counter, n) (::serde::thread_counters().counter += (n))
+#define SERDE_COUNT_MAX(counter, n)                                            \
+    (::serde::thread_counters().counter =                                      \
+         std::max(::serde::thread_counters().counter, (size_t)(n)))
+#define SERDE_TIME_TYPE(type_name, operation)                                  \
+    ::serde::TypeTimer serde_type_timer(type_name, operation)
+#else
+#define SERDE_COUNT(counter, n) ((void)0)
+#define SERDE_COUNT_MAX(counter, n) ((void)0)
+#define SERDE_TIME_TYPE(type_name, operation) ((void)0)
+#endif
+
 namespace serde {
 
 class serialization_error : public std::invalid_argument {
@@ -33,6 +155,98 @@ class deserialization_error : public std::invalid_argument {
         : std::invalid_argument(what_arg) {}
 };
 
+// Reasons for rejecting an input during deserialization.
+enum class deserialization_errc {
+    ok = 0,
+    input_too_short,
+    trailing_bytes,
+    invalid_bool,
+    invalid_utf8,
+    invalid_uleb128,
+    uleb128_overflow,
+    length_too_large,
+    unknown_variant_index,
+    unsorted_map_keys,
+    too_many_nested_containers,
+    not_implemented,
+    invalid_varint,
+    varint_overflow,
+};
+
+inline const char *error_message(deserialization_errc code) {
+    switch (code) {
+    case deserialization_errc::ok:
+        return "No error";
+    case deserialization_errc::input_too_short:
+        return "Input is not large enough";
+    case deserialization_errc::trailing_bytes:
+        return "Some input bytes were not read";
+    case deserialization_errc::invalid_bool:
+        return "Invalid boolean value";
+    case deserialization_errc::invalid_utf8:
+        return "Invalid UTF8 string";
+    case deserialization_errc::invalid_uleb128:
+        return "Invalid uleb128 number (unexpected zero digit)";
+    case deserialization_errc::uleb128_overflow:
+        return "Overflow while parsing uleb128-encoded uint32 value";
+    case deserialization_errc::length_too_large:
+        return "Length is too large";
+    case deserialization_errc::unknown_variant_index:
+        return "Unknown variant index for enum";
+    case deserialization_errc::unsorted_map_keys:
+        return "Error while decoding map: keys are not serialized in the "
+               "expected order";
+    case deserialization_errc::too_many_nested_containers:
+        return "Too many nested containers";
+    case deserialization_errc::not_implemented:
+        return "not implemented";
+    case deserialization_errc::invalid_varint:
+        return "Invalid varint number (unexpected tag byte)";
+    case deserialization_errc::varint_overflow:
+        return "Overflow while parsing varint-encoded integer value";
+    }
+    return "Unknown error";
+}
+
+// First error met by a deserializer, and the input offset where it was
+// detected.
+struct deserialization_failure {
+    deserialization_errc code;
+    size_t offset;
+
+    const char *what() const { return error_message(code); }
+};
+
+// Either a deserialized value or the reason why the input was rejected, in
+// the spirit of `std::expected`. Accessing the value of a failed result is
+// undefined behavior.
+template <typename T>
+class deserialization_result {
+    std::variant<T, deserialization_failure> storage_;
+
+  public:
+    deserialization_result(T value)
+        : storage_(std::in_place_index<0>, std::move(value)) {}
+    deserialization_result(deserialization_failure failure)
+        : storage_(std::in_place_index<1>, failure) {}
+
+    bool has_value() const { return storage_.index() == 0; }
+    explicit operator bool() const { return has_value(); }
+
+    T &value() & { return *std::get_if<0>(&storage_); }
+    const T &value() const & { return *std::get_if<0>(&storage_); }
+    T value() && { return std::move(*std::get_if<0>(&storage_)); }
+
+    T &operator*() & { return value(); }
+    const T &operator*() const & { return value(); }
+    T *operator->() { return &value(); }
+    const T *operator->() const { return &value(); }
+
+    const deserialization_failure &error() const {
+        return *std::get_if<1>(&storage_);
+    }
+};
+
 // Basic implementation for 128-bit unsigned integers.
 struct uint128_t {
     uint64_t high;
@@ -60,53 +274,481 @@ inline bool operator==(const int128_t &lhs, const int128_t &rhs) {
 // A copyable unique_ptr with value semantics.
 // Freely inspired by the following discussion:
 // https://codereview.stackexchange.com/questions/103744/deepptr-a-deep-copying-unique-ptr-wrapper-in-c
-template <typename T>
+// Storage is obtained from `Allocator`. Like standard containers, a
+// value_ptr keeps its allocator on copy-assignment, so that copies do not
+// leak out of an arena.
+template <typename T, typename Allocator = std::allocator<T>>
 class value_ptr {
+    using Traits = std::allocator_traits<Allocator>;
+
   public:
-    value_ptr() : ptr_(nullptr) {}
+    using allocator_type = Allocator;
+
+    value_ptr() : storage_(Allocator()) {}
 
-    value_ptr(const T &value) : ptr_(new T{value}) {}
+    explicit value_ptr(const Allocator &allocator) : storage_(allocator) {}
+
+    value_ptr(const T &value, const Allocator &allocator = Allocator())
+        : storage_(allocator) {
+        storage_.ptr = create(value);
+    }
 
-    value_ptr(const value_ptr &other) : ptr_(nullptr) {
+    value_ptr(T &&value, const Allocator &allocator = Allocator())
+        : storage_(allocator) {
+        storage_.ptr = create(std::move(value));
+    }
+
+    // Construct the pointed value in place from the arguments.
+    template <typename... Args>
+    explicit value_ptr(std::in_place_t, const Allocator &allocator,
+                       Args &&... args)
+        : storage_(allocator) {
+        storage_.ptr = create(std::forward<Args>(args)...);
+    }
+
+    // Construct the pointed value in place from the result of `make()`, e.g.
+    // a decoded value, which is then neither copied nor moved.
+    template <typename Make>
+    static value_ptr from_result(Make &&make,
+                                 const Allocator &allocator = Allocator()) {
+        value_ptr result(allocator);
+        Allocator &storage_allocator = result.storage_;
+        T *ptr = Traits::allocate(storage_allocator, 1);
+        SERDE_COUNT(allocations, 1);
+#if SERDE_EXCEPTIONS
+        try {
+            ::new (static_cast<void *>(ptr)) T(make());
+        } catch (...) {
+            Traits::deallocate(storage_allocator, ptr, 1);
+            throw;
+        }
+#else
+        ::new (static_cast<void *>(ptr)) T(make());
+#endif
+        result.storage_.ptr = ptr;
+        return result;
+    }
+
+    value_ptr(const value_ptr &other)
+        : storage_(Traits::select_on_container_copy_construction(
+              other.get_allocator())) {
         if (other) {
-            ptr_ = std::unique_ptr<T>{new T{*other}};
+            storage_.ptr = create(*other);
         }
     }
 
     value_ptr &operator=(const value_ptr &other) {
-        value_ptr temp{other};
-        std::swap(ptr_, temp.ptr_);
+        if (this != &other) {
+            value_ptr temp{other.storage_.ptr ? create(*other) : nullptr,
+                           get_allocator()};
+            swap_pointers(temp);
+        }
         return *this;
     }
 
-    value_ptr(value_ptr &&other) = default;
+    value_ptr(value_ptr &&other) noexcept : storage_(other.get_allocator()) {
+        swap_pointers(other);
+    }
 
-    value_ptr &operator=(value_ptr &&other) = default;
+    value_ptr &operator=(value_ptr &&other) {
+        if (this == &other) {
+            return *this;
+        }
+        if (get_allocator() == other.get_allocator()) {
+            value_ptr temp{std::move(other)};
+            swap_pointers(temp);
+        } else {
+            value_ptr temp{other ? create(std::move(*other)) : nullptr,
+                           get_allocator()};
+            swap_pointers(temp);
+        }
+        return *this;
+    }
 
-    T &operator*() { return *ptr_; }
+    ~value_ptr() {
+        if (storage_.ptr) {
+            Allocator &allocator = storage_;
+            Traits::destroy(allocator, storage_.ptr);
+            Traits::deallocate(allocator, storage_.ptr, 1);
+        }
+    }
+
+    T &operator*() { return *storage_.ptr; }
+
+    const T &operator*() const { return *storage_.ptr; }
 
-    const T &operator*() const { return *ptr_; }
+    T *const operator->() { return storage_.ptr; }
 
-    T *const operator->() { return ptr_.operator->(); }
+    const T *const operator->() const { return storage_.ptr; }
 
-    const T *const operator->() const { return ptr_.operator->(); }
+    const T *const get() const { return storage_.ptr; }
 
-    const T *const get() const { return ptr_.get(); }
+    operator bool() const { return storage_.ptr != nullptr; }
 
-    operator bool() const { return (bool)ptr_; }
+    Allocator get_allocator() const { return storage_; }
 
-    template <typename U>
-    friend bool operator==(const value_ptr<U> &, const value_ptr<U> &);
+    template <typename U, typename A>
+    friend bool operator==(const value_ptr<U, A> &, const value_ptr<U, A> &);
 
   private:
-    std::unique_ptr<T> ptr_;
+    // Stateless allocators take no space.
+    struct Storage : Allocator {
+        explicit Storage(const Allocator &allocator) : Allocator(allocator) {}
+        T *ptr = nullptr;
+    };
+
+    // Take ownership of `ptr`, which was obtained from `allocator`.
+    value_ptr(T *ptr, const Allocator &allocator) : storage_(allocator) {
+        storage_.ptr = ptr;
+    }
+
+    template <typename... Args>
+    T *create(Args &&... args) {
+        Allocator &allocator = storage_;
+        T *ptr = Traits::allocate(allocator, 1);
+        SERDE_COUNT(allocations, 1);
+#if SERDE_EXCEPTIONS
+        try {
+            Traits::construct(allocator, ptr, std::forward<Args>(args)...);
+        } catch (...) {
+            Traits::deallocate(allocator, ptr, 1);
+            throw;
+        }
+#else
+        Traits::construct(allocator, ptr, std::forward<Args>(args)...);
+#endif
+        return ptr;
+    }
+
+    void swap_pointers(value_ptr &other) {
+        std::swap(storage_.ptr, other.storage_.ptr);
+    }
+
+    Storage storage_;
 };
 
+template <typename T, typename A>
+bool operator==(const value_ptr<T, A> &lhs, const value_ptr<T, A> &rhs) {
+    // Moved-from pointers are empty.
+    if (!lhs || !rhs) {
+        return !lhs && !rhs;
+    }
+    return lhs.get() == rhs.get() || *lhs == *rhs;
+}
+
+#if defined(__cpp_lib_memory_resource)
+namespace pmr {
+
 template <typename T>
-bool operator==(const value_ptr<T> &lhs, const value_ptr<T> &rhs) {
-    return *lhs == *rhs;
+using value_ptr = serde::value_ptr<T, std::pmr::polymorphic_allocator<T>>;
+
+} // end of namespace pmr
+#endif
+
+// --- Hashing ---
+
+// Hash function of the keys of hash maps in generated code. Unlike
+// `std::hash`, it covers the standard containers used in generated types.
+// Generated types provide a `hash_value` function found by argument-dependent
+// lookup.
+template <typename T, typename = void>
+struct hash : std::hash<T> {};
+
+template <typename T>
+struct hash<T, std::void_t<decltype(hash_value(std::declval<const T &>()))>> {
+    size_t operator()(const T &value) const { return hash_value(value); }
+};
+
+inline size_t hash_combine(size_t seed, size_t hash) {
+    return seed ^ (hash + (size_t)0x9e3779b97f4a7c15ull + (seed << 6) +
+                   (seed >> 2));
+}
+
+// Hash of the given values, in order.
+template <typename... Types>
+size_t hash_values(const Types &... values) {
+    size_t seed = 0;
+    ((seed = hash_combine(seed, hash<Types>()(values))), ...);
+    return seed;
 }
 
+// Hash of the values in [begin, end), in order.
+template <typename Iterator>
+size_t hash_range(Iterator begin, Iterator end) {
+    using T = typename std::iterator_traits<Iterator>::value_type;
+    size_t seed = 0;
+    for (; begin != end; ++begin) {
+        seed = hash_combine(seed, hash<T>()(*begin));
+    }
+    return seed;
+}
+
+template <>
+struct hash<uint128_t> {
+    size_t operator()(const uint128_t &value) const {
+        return hash_values(value.high, value.low);
+    }
+};
+
+template <>
+struct hash<int128_t> {
+    size_t operator()(const int128_t &value) const {
+        return hash_values(value.high, value.low);
+    }
+};
+
+template <typename Allocator>
+struct hash<std::basic_string<char, std::char_traits<char>, Allocator>> {
+    size_t operator()(
+        const std::basic_string<char, std::char_traits<char>, Allocator> &value)
+        const {
+        return std::hash<std::string_view>()(value);
+    }
+};
+
+template <typename T, typename Allocator>
+struct hash<value_ptr<T, Allocator>> {
+    size_t operator()(const value_ptr<T, Allocator> &value) const {
+        return hash<T>()(*value);
+    }
+};
+
+template <typename T>
+struct hash<std::optional<T>> {
+    size_t operator()(const std::optional<T> &value) const {
+        return value.has_value() ? hash_combine(1, hash<T>()(*value)) : 0;
+    }
+};
+
+template <typename T, typename Allocator>
+struct hash<std::vector<T, Allocator>> {
+    size_t operator()(const std::vector<T, Allocator> &value) const {
+        return hash_range(value.begin(), value.end());
+    }
+};
+
+template <typename T, std::size_t N>
+struct hash<std::array<T, N>> {
+    size_t operator()(const std::array<T, N> &value) const {
+        return hash_range(value.begin(), value.end());
+    }
+};
+
+template <typename K, typename V, typename Compare, typename Allocator>
+struct hash<std::map<K, V, Compare, Allocator>> {
+    size_t operator()(const std::map<K, V, Compare, Allocator> &value) const {
+        return hash_range(value.begin(), value.end());
+    }
+};
+
+// Equal hash maps may iterate in different orders: the hashes of their entries
+// are combined with a commutative operation.
+template <typename K, typename V, typename Hash, typename Equal,
+          typename Allocator>
+struct hash<std::unordered_map<K, V, Hash, Equal, Allocator>> {
+    size_t operator()(
+        const std::unordered_map<K, V, Hash, Equal, Allocator> &value) const {
+        size_t sum = 0;
+        for (const auto &entry : value) {
+            sum += hash_values(entry.first, entry.second);
+        }
+        return hash_combine(value.size(), sum);
+    }
+};
+
+template <typename T1, typename T2>
+struct hash<std::pair<T1, T2>> {
+    size_t operator()(const std::pair<T1, T2> &value) const {
+        return hash_values(value.first, value.second);
+    }
+};
+
+template <typename... Types>
+struct hash<std::tuple<Types...>> {
+    size_t operator()(const std::tuple<Types...> &value) const {
+        return std::apply(
+            [](const auto &... items) { return hash_values(items...); },
+            value);
+    }
+};
+
+template <typename... Types>
+struct hash<std::variant<Types...>> {
+    size_t operator()(const std::variant<Types...> &value) const {
+        return hash_combine(value.index(),
+                            std::visit(
+                                [](const auto &item) {
+                                    using T = std::decay_t<decltype(item)>;
+                                    return hash<T>()(item);
+                                },
+                                value));
+    }
+};
+
+// --- Flat maps ---
+
+// Map storing its entries in a vector sorted by key: lookups are logarithmic
+// and iteration is contiguous, while insertions and removals move the
+// following entries. Suited to large maps that are decoded once, then read.
+// When given unsorted entries, the first entry of each key is kept.
+template <typename K, typename V, typename Compare = std::less<K>,
+          typename Allocator = std::allocator<std::pair<K, V>>>
+class flat_map {
+  public:
+    using key_type = K;
+    using mapped_type = V;
+    using value_type = std::pair<K, V>;
+    using key_compare = Compare;
+    using allocator_type = Allocator;
+    using container_type = std::vector<value_type, Allocator>;
+    using size_type = size_t;
+    using iterator = typename container_type::iterator;
+    using const_iterator = typename container_type::const_iterator;
+
+    flat_map() = default;
+    explicit flat_map(const Allocator &allocator) : entries_(allocator) {}
+    flat_map(std::initializer_list<value_type> entries,
+             const Allocator &allocator = Allocator())
+        : entries_(entries, allocator) {
+        sort_entries();
+    }
+    explicit flat_map(container_type entries) : entries_(std::move(entries)) {
+        sort_entries();
+    }
+
+    iterator begin() { return entries_.begin(); }
+    const_iterator begin() const { return entries_.begin(); }
+    iterator end() { return entries_.end(); }
+    const_iterator end() const { return entries_.end(); }
+
+    size_t size() const { return entries_.size(); }
+    bool empty() const { return entries_.empty(); }
+    void clear() { entries_.clear(); }
+    void reserve(size_t size) { entries_.reserve(size); }
+    allocator_type get_allocator() const { return entries_.get_allocator(); }
+
+    iterator lower_bound(const K &key) {
+        return std::lower_bound(begin(), end(), key, key_less{compare_});
+    }
+    const_iterator lower_bound(const K &key) const {
+        return std::lower_bound(begin(), end(), key, key_less{compare_});
+    }
+    iterator find(const K &key) {
+        auto it = lower_bound(key);
+        return it != end() && !compare_(key, it->first) ? it : end();
+    }
+    const_iterator find(const K &key) const {
+        auto it = lower_bound(key);
+        return it != end() && !compare_(key, it->first) ? it : end();
+    }
+    size_t count(const K &key) const { return find(key) != end(); }
+
+    V &at(const K &key) {
+        auto it = find(key);
+        if (it == end()) {
+            SERDE_THROW(std::out_of_range("flat_map::at"));
+        }
+        return it->second;
+    }
+    const V &at(const K &key) const {
+        auto it = find(key);
+        if (it == end()) {
+            SERDE_THROW(std::out_of_range("flat_map::at"));
+        }
+        return it->second;
+    }
+    V &operator[](const K &key) { return try_emplace(key).first->second; }
+
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const K &key, Args &&... args) {
+        auto it = lower_bound(key);
+        if (it != end() && !compare_(key, it->first)) {
+            return {it, false};
+        }
+        it = entries_.emplace(
+            it, std::piecewise_construct, std::forward_as_tuple(key),
+            std::forward_as_tuple(std::forward<Args>(args)...));
+        return {it, true};
+    }
+    std::pair<iterator, bool> insert(value_type entry) {
+        auto it = lower_bound(entry.first);
+        if (it != end() && !compare_(entry.first, it->first)) {
+            return {it, false};
+        }
+        return {entries_.insert(it, std::move(entry)), true};
+    }
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(Args &&... args) {
+        return insert(value_type(std::forward<Args>(args)...));
+    }
+    iterator erase(const_iterator pos) { return entries_.erase(pos); }
+    size_t erase(const K &key) {
+        auto it = find(key);
+        if (it == end()) {
+            return 0;
+        }
+        entries_.erase(it);
+        return 1;
+    }
+
+    // Give back the entries, e.g. to reuse their storage with `replace`.
+    container_type extract() && { return std::move(entries_); }
+    // Replace the entries with the given ones, in any order.
+    void replace(container_type entries) {
+        entries_ = std::move(entries);
+        sort_entries();
+    }
+
+    friend bool operator==(const flat_map &lhs, const flat_map &rhs) {
+        return lhs.entries_ == rhs.entries_;
+    }
+
+  private:
+    struct key_less {
+        const Compare &compare;
+        bool operator()(const value_type &entry, const K &key) const {
+            return compare(entry.first, key);
+        }
+        bool operator()(const value_type &lhs, const value_type &rhs) const {
+            return compare(lhs.first, rhs.first);
+        }
+    };
+
+    // Entries are usually given in order (e.g. integer keys in BCS).
+    void sort_entries() {
+        key_less less{compare_};
+        if (!std::is_sorted(entries_.begin(), entries_.end(), less)) {
+            std::stable_sort(entries_.begin(), entries_.end(), less);
+        }
+        auto last = std::unique(entries_.begin(), entries_.end(),
+                                [&](const auto &lhs, const auto &rhs) {
+                                    return !less(lhs, rhs);
+                                });
+        entries_.erase(last, entries_.end());
+    }
+
+    container_type entries_;
+    Compare compare_;
+};
+
+template <typename K, typename V, typename Compare, typename Allocator>
+struct hash<flat_map<K, V, Compare, Allocator>> {
+    size_t operator()(const flat_map<K, V, Compare, Allocator> &value) const {
+        return hash_range(value.begin(), value.end());
+    }
+};
+
+#if defined(__cpp_lib_memory_resource)
+namespace pmr {
+
+template <typename K, typename V, typename Compare = std::less<K>>
+using flat_map =
+    serde::flat_map<K, V, Compare,
+                    std::pmr::polymorphic_allocator<std::pair<K, V>>>;
+
+} // end of namespace pmr
+#endif
+
 // Trait to enable serialization of values of type T.
 // This is similar to the `serde::Serialize` trait in Rust.
 template <typename T>
@@ -123,13 +765,190 @@ struct Deserializable {
     static T deserialize(Deserializer &deserializer);
 };
 
+// Trait to consume the encoding of a value of type T without building it.
+// Skipping accepts exactly the inputs that deserialization accepts, but does
+// not allocate. By default, values are deserialized then dropped, which is
+// the best we can do for base types.
+template <typename T>
+struct Skippable {
+    template <typename Deserializer>
+    static void skip(Deserializer &deserializer) {
+        Deserializable<T>::deserialize(deserializer);
+    }
+};
+
+// Trait to deserialize a value of type T into an existing value, reusing its
+// storage: the capacity of strings and vectors, the nodes of maps, the
+// allocations of value pointers and the current alternative of variants. By
+// default, a new value is deserialized then moved into place.
+template <typename T>
+struct DeserializableInto {
+    template <typename Deserializer>
+    static void deserialize_into(T &value, Deserializer &deserializer) {
+        value = Deserializable<T>::deserialize(deserializer);
+    }
+};
+
+// --- Static encoded sizes ---
+
+// Trait describing types whose binary encoding always has the same size.
+// `value` is only meaningful when `is_static` is true.
+template <typename T>
+struct EncodedSize {
+    static constexpr bool is_static = false;
+    static constexpr size_t value = 0;
+};
+
+template <size_t N>
+struct StaticEncodedSize {
+    static constexpr bool is_static = true;
+    static constexpr size_t value = N;
+};
+
+// Encoded size of a sequence of values written without separators, e.g. the
+// fields of a struct.
+template <typename... Types>
+struct EncodedSizeOf {
+    static constexpr bool is_static = (EncodedSize<Types>::is_static && ...);
+    static constexpr size_t value =
+        is_static ? (EncodedSize<Types>::value + ... + 0) : 0;
+};
+
+template <>
+struct EncodedSize<std::monostate> : StaticEncodedSize<0> {};
+
+template <>
+struct EncodedSize<bool> : StaticEncodedSize<1> {};
+
+template <>
+struct EncodedSize<float> : StaticEncodedSize<4> {};
+
+template <>
+struct EncodedSize<double> : StaticEncodedSize<8> {};
+
+template <>
+struct EncodedSize<uint8_t> : StaticEncodedSize<1> {};
+
+template <>
+struct EncodedSize<uint16_t> : StaticEncodedSize<2> {};
+
+template <>
+struct EncodedSize<uint32_t> : StaticEncodedSize<4> {};
+
+template <>
+struct EncodedSize<uint64_t> : StaticEncodedSize<8> {};
+
+template <>
+struct EncodedSize<uint128_t> : StaticEncodedSize<16> {};
+
+template <>
+struct EncodedSize<int8_t> : StaticEncodedSize<1> {};
+
+template <>
+struct EncodedSize<int16_t> : StaticEncodedSize<2> {};
+
+template <>
+struct EncodedSize<int32_t> : StaticEncodedSize<4> {};
+
+template <>
+struct EncodedSize<int64_t> : StaticEncodedSize<8> {};
+
+template <>
+struct EncodedSize<int128_t> : StaticEncodedSize<16> {};
+
+template <typename... Types>
+struct EncodedSize<std::tuple<Types...>> : EncodedSizeOf<Types...> {};
+
+template <typename T, std::size_t N>
+struct EncodedSize<std::array<T, N>> {
+    static constexpr bool is_static = EncodedSize<T>::is_static;
+    static constexpr size_t value = is_static ? N * EncodedSize<T>::value : 0;
+};
+
+// --- In-memory layouts ---
+
+// Trait describing types whose binary encoding is their in-memory
+// representation on little-endian hosts: fixed-width integers, arrays of such
+// types, and generated structs that contain only such fields (see
+// `MemcpyLayoutOf`). `depth` is the number of nested containers in a value.
+template <typename T>
+struct MemcpyLayout {
+    static constexpr bool value = false;
+    static constexpr size_t depth = 0;
+};
+
+template <size_t Depth>
+struct StaticMemcpyLayout {
+    static constexpr bool value = true;
+    static constexpr size_t depth = Depth;
+};
+
+template <>
+struct MemcpyLayout<uint8_t> : StaticMemcpyLayout<0> {};
+
+template <>
+struct MemcpyLayout<uint16_t> : StaticMemcpyLayout<0> {};
+
+template <>
+struct MemcpyLayout<uint32_t> : StaticMemcpyLayout<0> {};
+
+template <>
+struct MemcpyLayout<uint64_t> : StaticMemcpyLayout<0> {};
+
+template <>
+struct MemcpyLayout<int8_t> : StaticMemcpyLayout<0> {};
+
+template <>
+struct MemcpyLayout<int16_t> : StaticMemcpyLayout<0> {};
+
+template <>
+struct MemcpyLayout<int32_t> : StaticMemcpyLayout<0> {};
+
+template <>
+struct MemcpyLayout<int64_t> : StaticMemcpyLayout<0> {};
+
+template <typename T, std::size_t N>
+struct MemcpyLayout<std::array<T, N>> {
+    static constexpr bool value = MemcpyLayout<T>::value &&
+                                  sizeof(std::array<T, N>) == N * sizeof(T);
+    static constexpr size_t depth = MemcpyLayout<T>::depth;
+};
+
+// Layout of a struct `T` whose fields have the given types, in declaration
+// order. Without padding, the fields of a standard-layout struct are stored
+// back to back in that order, i.e. exactly as they are encoded.
+template <typename T, typename... Fields>
+struct MemcpyLayoutOf {
+    static constexpr bool value =
+        std::is_trivially_copyable<T>::value &&
+        std::is_standard_layout<T>::value &&
+        (MemcpyLayout<Fields>::value && ...) &&
+        sizeof(T) == (sizeof(Fields) + ... + 0);
+    static constexpr size_t depth =
+        1 + std::max({size_t(0), MemcpyLayout<Fields>::depth...});
+};
+
+// Whether the given (de)serializer may copy values of a type with a memcpy
+// layout in bulk. Like any other container, the structs nested in these values
+// must fit in the remaining container depth budget. They contain no sequences,
+// so parallel (de)serialization does not need their depth.
+template <typename T, typename S>
+bool can_copy_in_bulk(const S &serializer) {
+    return MemcpyLayout<T>::depth == 0 ||
+           serializer.fits_container_depth(MemcpyLayout<T>::depth);
+}
+
 // --- Implementation of Serializable for base types ---
 
 // string
-template <>
-struct Serializable<std::string> {
+template <typename Allocator>
+struct Serializable<
+    std::basic_string<char, std::char_traits<char>, Allocator>> {
     template <typename Serializer>
-    static void serialize(const std::string &value, Serializer &serializer) {
+    static void
+    serialize(const std::basic_string<char, std::char_traits<char>, Allocator>
+                  &value,
+              Serializer &serializer) {
         serializer.serialize_str(value);
     }
 };
@@ -273,10 +1092,11 @@ struct Serializable<int128_t> {
 // --- Derivation of Serializable for composite types ---
 
 // Value pointers (non-nullable)
-template <typename T>
-struct Serializable<value_ptr<T>> {
+template <typename T, typename Allocator>
+struct Serializable<value_ptr<T, Allocator>> {
     template <typename Serializer>
-    static void serialize(const value_ptr<T> &value, Serializer &serializer) {
+    static void serialize(const value_ptr<T, Allocator> &value,
+                          Serializer &serializer) {
         Serializable<T>::serialize(*value, serializer);
     }
 };
@@ -303,8 +1123,20 @@ struct Serializable<std::vector<T, Allocator>> {
     static void serialize(const std::vector<T, Allocator> &value,
                           Serializer &serializer) {
         serializer.serialize_len(value.size());
-        for (const T &item : value) {
-            Serializable<T>::serialize(item, serializer);
+        if constexpr (Serializer::template is_bulk_copyable<T>) {
+            if (can_copy_in_bulk<T>(serializer)) {
+                serializer.serialize_raw_bytes(
+                    reinterpret_cast<const uint8_t *>(value.data()),
+                    value.size() * sizeof(T));
+                return;
+            }
+        }
+        if (serializer.should_encode_in_parallel(value.size())) {
+            serializer.serialize_elements_in_parallel(value);
+        } else {
+            for (const T &item : value) {
+                Serializable<T>::serialize(item, serializer);
+            }
         }
     }
 };
@@ -315,20 +1147,44 @@ struct Serializable<std::array<T, N>> {
     template <typename Serializer>
     static void serialize(const std::array<T, N> &value,
                           Serializer &serializer) {
+        if constexpr (Serializer::template is_bulk_copyable<T>) {
+            if (can_copy_in_bulk<T>(serializer)) {
+                serializer.serialize_raw_bytes(
+                    reinterpret_cast<const uint8_t *>(value.data()),
+                    N * sizeof(T));
+                return;
+            }
+        }
         for (const T &item : value) {
             Serializable<T>::serialize(item, serializer);
         }
     }
 };
 
-// Maps
-template <typename K, typename V, typename Allocator>
-struct Serializable<std::map<K, V, Allocator>> {
+// Maps. Entries are written in iteration order, then sorted by serializers
+// that `enforce_strict_map_ordering` (e.g. BCS), so that any map type can
+// reuse `SerializableMap`. Custom map templates may be supported with e.g.
+//   template <typename K, typename V>
+//   struct serde::Serializable<my::map<K, V>>
+//       : serde::SerializableMap<my::map<K, V>> {};
+// and likewise with `DeserializableMap`, `DeserializableIntoMap` and
+// `SkippableMap`.
+template <typename Map>
+struct SerializableMap {
     template <typename Serializer>
-    static void serialize(const std::map<K, V, Allocator> &value,
-                          Serializer &serializer) {
+    static void serialize(const Map &value, Serializer &serializer) {
+        using K = typename Map::key_type;
+        using V = typename Map::mapped_type;
         serializer.serialize_len(value.size());
+        if (serializer.should_encode_in_parallel(value.size())) {
+            serializer.serialize_entries_in_parallel(value);
+            return;
+        }
         std::vector<size_t> offsets;
+        if constexpr (Serializer::enforce_strict_map_ordering) {
+            offsets.reserve(value.size());
+            serializer.begin_map_entries();
+        }
         for (const auto &item : value) {
             if constexpr (Serializer::enforce_strict_map_ordering) {
                 offsets.push_back(serializer.get_buffer_offset());
@@ -337,11 +1193,24 @@ struct Serializable<std::map<K, V, Allocator>> {
             Serializable<V>::serialize(item.second, serializer);
         }
         if constexpr (Serializer::enforce_strict_map_ordering) {
-            serializer.sort_last_entries(std::move(offsets));
+            serializer.sort_last_entries(offsets);
         }
     }
 };
 
+template <typename K, typename V, typename Compare, typename Allocator>
+struct Serializable<std::map<K, V, Compare, Allocator>>
+    : SerializableMap<std::map<K, V, Compare, Allocator>> {};
+
+template <typename K, typename V, typename Hash, typename Equal,
+          typename Allocator>
+struct Serializable<std::unordered_map<K, V, Hash, Equal, Allocator>>
+    : SerializableMap<std::unordered_map<K, V, Hash, Equal, Allocator>> {};
+
+template <typename K, typename V, typename Compare, typename Allocator>
+struct Serializable<flat_map<K, V, Compare, Allocator>>
+    : SerializableMap<flat_map<K, V, Compare, Allocator>> {};
+
 // Tuples
 template <class... Types>
 struct Serializable<std::tuple<Types...>> {
@@ -375,14 +1244,31 @@ struct Serializable<std::variant<Types...>> {
     }
 };
 
+// Allocator for the memory of a value being deserialized. Polymorphic
+// allocators draw from the memory resource of the deserializer, so that a
+// whole message can be decoded into an arena.
+template <typename Allocator, typename Deserializer>
+Allocator make_allocator(Deserializer &deserializer) {
+#if defined(__cpp_lib_memory_resource)
+    if constexpr (std::is_constructible<Allocator,
+                                        std::pmr::memory_resource *>::value) {
+        return Allocator(deserializer.get_memory_resource());
+    }
+#endif
+    return Allocator();
+}
+
 // --- Implementation of Deserializable for base types ---
 
 // string
-template <>
-struct Deserializable<std::string> {
+template <typename Allocator>
+struct Deserializable<
+    std::basic_string<char, std::char_traits<char>, Allocator>> {
     template <typename Deserializer>
-    static std::string deserialize(Deserializer &deserializer) {
-        return deserializer.deserialize_str();
+    static std::basic_string<char, std::char_traits<char>, Allocator>
+    deserialize(Deserializer &deserializer) {
+        return deserializer.deserialize_str(
+            make_allocator<Allocator>(deserializer));
     }
 };
 
@@ -523,12 +1409,30 @@ struct Deserializable<int128_t> {
 
 // --- Derivation of Deserializable for composite types ---
 
-// Value pointers
+// Capacity to reserve for `len` values of type `T` read from
+// `remaining_bytes` bytes of input. Assuming that every value takes at least
+// one byte, hostile lengths cannot make us allocate much more than the size
+// of the input.
 template <typename T>
-struct Deserializable<value_ptr<T>> {
+size_t bounded_capacity(size_t len, size_t remaining_bytes) {
+    constexpr size_t min_size =
+        EncodedSize<T>::value > 0 ? EncodedSize<T>::value : 1;
+    return std::min(len, remaining_bytes / min_size);
+}
+
+// Value pointers
+template <typename T, typename Allocator>
+struct Deserializable<value_ptr<T, Allocator>> {
     template <typename Deserializer>
-    static value_ptr<T> deserialize(Deserializer &deserializer) {
-        return value_ptr<T>(Deserializable<T>::deserialize(deserializer));
+    static value_ptr<T, Allocator> deserialize(Deserializer &deserializer) {
+        // After an error, stop following (possibly recursive) pointers.
+        if (deserializer.has_failed()) {
+            return value_ptr<T, Allocator>(
+                make_allocator<Allocator>(deserializer));
+        }
+        return value_ptr<T, Allocator>::from_result(
+            [&] { return Deserializable<T>::deserialize(deserializer); },
+            make_allocator<Allocator>(deserializer));
     }
 };
 
@@ -550,56 +1454,174 @@ struct Deserializable<std::optional<T>> {
 template <typename T, typename Allocator>
 struct Deserializable<std::vector<T, Allocator>> {
     template <typename Deserializer>
-    static std::vector<T> deserialize(Deserializer &deserializer) {
-        std::vector<T> result;
+    static std::vector<T, Allocator> deserialize(Deserializer &deserializer) {
+        std::vector<T, Allocator> result(
+            make_allocator<Allocator>(deserializer));
         size_t len = deserializer.deserialize_len();
-        for (size_t i = 0; i < len; i++) {
-            result.push_back(Deserializable<T>::deserialize(deserializer));
+        if constexpr (Deserializer::template is_bulk_copyable<T>) {
+            if (len > SIZE_MAX / sizeof(T)) {
+                deserializer.fail(deserialization_errc::length_too_large);
+                return result;
+            }
+            if (can_copy_in_bulk<T>(deserializer)) {
+                auto bytes =
+                    deserializer.deserialize_raw_bytes(len * sizeof(T));
+                if (bytes != nullptr && len > 0) {
+                    SERDE_COUNT(allocations, 1);
+                    // Copy the items straight into place, unless the input is
+                    // misaligned for `T`.
+                    if (reinterpret_cast<uintptr_t>(bytes) % alignof(T) == 0) {
+                        auto begin = reinterpret_cast<const T *>(bytes);
+                        result.assign(begin, begin + len);
+                    } else {
+                        result.resize(len);
+                        std::memcpy(result.data(), bytes, len * sizeof(T));
+                    }
+                }
+                return result;
+            }
+        }
+        if (deserializer.should_decode_in_parallel(len)) {
+            deserializer.deserialize_elements_in_parallel(result, len);
+            return result;
+        }
+        result.reserve(
+            bounded_capacity<T>(len, deserializer.get_remaining_bytes()));
+        SERDE_COUNT(allocations, result.capacity() > 0);
+        for (size_t i = 0; i < len && !deserializer.has_failed(); i++) {
+            result.emplace_back(Deserializable<T>::deserialize(deserializer));
         }
         return result;
     }
 };
 
-// Maps
-template <typename K, typename V>
-struct Deserializable<std::map<K, V>> {
+// Check the order of the map key that was just decoded from offset `start`.
+template <typename Deserializer>
+void check_map_key(
+    Deserializer &deserializer,
+    std::optional<std::tuple<size_t, size_t>> &previous_key_slice,
+    size_t start) {
+    if constexpr (Deserializer::enforce_strict_map_ordering) {
+        auto end = deserializer.get_buffer_offset();
+        if (previous_key_slice.has_value()) {
+            deserializer.check_that_key_slices_are_increasing(
+                previous_key_slice.value(), {start, end});
+        }
+        previous_key_slice = {start, end};
+    }
+}
+
+// Decode the `len` entries of a map and pass each of them to
+// `insert(key, value)`.
+template <typename K, typename V, typename Deserializer, typename Insert>
+void deserialize_map_entries(Deserializer &deserializer, size_t len,
+                             Insert insert) {
+    std::optional<std::tuple<size_t, size_t>> previous_key_slice;
+    if constexpr (Deserializer::enforce_strict_map_ordering) {
+        deserializer.begin_map_entries();
+    }
+    for (size_t i = 0; i < len && !deserializer.has_failed(); i++) {
+        auto start = deserializer.get_buffer_offset();
+        auto key = Deserializable<K>::deserialize(deserializer);
+        check_map_key(deserializer, previous_key_slice, start);
+        auto value = Deserializable<V>::deserialize(deserializer);
+        insert(std::move(key), std::move(value));
+    }
+    if constexpr (Deserializer::enforce_strict_map_ordering) {
+        deserializer.end_map_entries();
+    }
+}
+
+// Whether containers of type T have a `reserve(size)` method.
+template <typename T, typename = void>
+struct is_reservable : std::false_type {};
+
+template <typename T>
+struct is_reservable<
+    T, std::void_t<decltype(std::declval<T &>().reserve(size_t()))>>
+    : std::true_type {};
+
+// Maps with node-based storage (see `SerializableMap`).
+template <typename Map>
+struct DeserializableMap {
     template <typename Deserializer>
-    static std::map<K, V> deserialize(Deserializer &deserializer) {
-        std::map<K, V> result;
+    static Map deserialize(Deserializer &deserializer) {
+        using K = typename Map::key_type;
+        using V = typename Map::mapped_type;
+        Map result(make_allocator<typename Map::allocator_type>(deserializer));
         size_t len = deserializer.deserialize_len();
-        std::optional<std::tuple<size_t, size_t>> previous_key_slice;
-        for (size_t i = 0; i < len; i++) {
-            if constexpr (Deserializer::enforce_strict_map_ordering) {
-                auto start = deserializer.get_buffer_offset();
-                auto key = Deserializable<K>::deserialize(deserializer);
-                auto end = deserializer.get_buffer_offset();
-                if (previous_key_slice.has_value()) {
-                    deserializer.check_that_key_slices_are_increasing(
-                        previous_key_slice.value(), {start, end});
-                }
-                previous_key_slice = {start, end};
-                auto value = Deserializable<V>::deserialize(deserializer);
-                result.insert({key, value});
-            } else {
-                auto key = Deserializable<K>::deserialize(deserializer);
-                auto value = Deserializable<V>::deserialize(deserializer);
-                result.insert({key, value});
-            }
+        if constexpr (is_reservable<Map>::value) {
+            result.reserve(bounded_capacity<std::tuple<K, V>>(
+                len, deserializer.get_remaining_bytes()));
         }
+        deserialize_map_entries<K, V>(
+            deserializer, len, [&](K &&key, V &&value) {
+                // Encoded keys are sorted, which usually matches the order of
+                // ordered maps. Otherwise, the hint only costs a comparison.
+                result.emplace_hint(result.end(), std::move(key),
+                                    std::move(value));
+                SERDE_COUNT(allocations, 1);
+            });
         return result;
     }
 };
 
+template <typename K, typename V, typename Compare, typename Allocator>
+struct Deserializable<std::map<K, V, Compare, Allocator>>
+    : DeserializableMap<std::map<K, V, Compare, Allocator>> {};
+
+template <typename K, typename V, typename Hash, typename Equal,
+          typename Allocator>
+struct Deserializable<std::unordered_map<K, V, Hash, Equal, Allocator>>
+    : DeserializableMap<std::unordered_map<K, V, Hash, Equal, Allocator>> {};
+
+// Flat maps are filled in the order of the input, then sorted once.
+template <typename K, typename V, typename Compare, typename Allocator>
+struct Deserializable<flat_map<K, V, Compare, Allocator>> {
+    template <typename Deserializer>
+    static flat_map<K, V, Compare, Allocator>
+    deserialize(Deserializer &deserializer) {
+        typename flat_map<K, V, Compare, Allocator>::container_type entries(
+            make_allocator<Allocator>(deserializer));
+        size_t len = deserializer.deserialize_len();
+        entries.reserve(bounded_capacity<std::tuple<K, V>>(
+            len, deserializer.get_remaining_bytes()));
+        SERDE_COUNT(allocations, entries.capacity() > 0);
+        deserialize_map_entries<K, V>(deserializer, len,
+                                      [&](K &&key, V &&value) {
+                                          entries.emplace_back(
+                                              std::move(key), std::move(value));
+                                      });
+        return flat_map<K, V, Compare, Allocator>(std::move(entries));
+    }
+};
+
 // Fixed-size arrays
 template <typename T, std::size_t N>
 struct Deserializable<std::array<T, N>> {
     template <typename Deserializer>
     static std::array<T, N> deserialize(Deserializer &deserializer) {
-        std::array<T, N> result;
-        for (T &item : result) {
-            item = Deserializable<T>::deserialize(deserializer);
+        if constexpr (Deserializer::template is_bulk_copyable<T>) {
+            if (can_copy_in_bulk<T>(deserializer)) {
+                std::array<T, N> result{};
+                auto bytes = deserializer.deserialize_raw_bytes(N * sizeof(T));
+                if (bytes != nullptr) {
+                    std::memcpy(result.data(), bytes, N * sizeof(T));
+                }
+                return result;
+            }
         }
-        return result;
+        return deserialize_items(deserializer, std::make_index_sequence<N>{});
+    }
+
+  private:
+    // Braced initialization constructs the items in place, from left to
+    // right, and keeps the allocators they were decoded with.
+    template <typename Deserializer, size_t... Is>
+    static std::array<T, N> deserialize_items(Deserializer &deserializer,
+                                              std::index_sequence<Is...>) {
+        return {{(static_cast<void>(Is),
+                  Deserializable<T>::deserialize(deserializer))...}};
     }
 };
 
@@ -608,9 +1630,10 @@ template <class... Types>
 struct Deserializable<std::tuple<Types...>> {
     template <typename Deserializer>
     static std::tuple<Types...> deserialize(Deserializer &deserializer) {
-        // Visit each of the type components.
-        return std::make_tuple(
-            Deserializable<Types>::deserialize(deserializer)...);
+        // Visit each of the type components. Braced initialization guarantees
+        // that the components are deserialized from left to right.
+        return std::tuple<Types...>{
+            Deserializable<Types>::deserialize(deserializer)...};
     }
 };
 
@@ -619,31 +1642,448 @@ template <class... Types>
 struct Deserializable<std::variant<Types...>> {
     template <typename Deserializer>
     static std::variant<Types...> deserialize(Deserializer &deserializer) {
-        // A "case" is analog to a particular branch in switch-case over the
-        // index. Given the variant type `T` known statically, we create a
-        // closure that will deserialize a value `T` and return it as a variant.
-        using Case = std::function<std::variant<Types...>(Deserializer &)>;
-        auto make_case = [](auto tag) -> Case {
-            // Obtain the type `T` encoded in the type of `tag ==
-            // std::common_type<T>{}`.
-            using T = typename decltype(tag)::type;
-            auto f = [](Deserializer &de) {
-                return std::variant<Types...>(
-                    Deserializable<T>::deserialize(de));
-            };
-            return f;
-        };
-
-        // The static array of all the cases for this variant.
-        static const std::array<Case, sizeof...(Types)> cases = {
-            make_case(std::common_type<Types>{})...};
-
         // Read the variant index and execute the corresponding case.
         auto index = deserializer.deserialize_variant_index();
-        if (index > cases.size()) {
-            throw deserialization_error("Unknown variant index for enum");
+        if (index >= sizeof...(Types)) {
+            deserializer.fail(deserialization_errc::unknown_variant_index);
+            index = 0;
+        }
+        return dispatch(index, deserializer,
+                        std::index_sequence_for<Types...>{});
+    }
+
+  private:
+    // A "case" is analog to a particular branch in switch-case over the
+    // index. It deserializes the `I`-th alternative and returns it as a
+    // variant.
+    template <size_t I, typename Deserializer>
+    static std::variant<Types...> deserialize_case(Deserializer &deserializer) {
+        using T = std::variant_alternative_t<I, std::variant<Types...>>;
+        return std::variant<Types...>(
+            std::in_place_index<I>,
+            Deserializable<T>::deserialize(deserializer));
+    }
+
+    template <typename Deserializer, size_t... Is>
+    static std::variant<Types...> dispatch(size_t index,
+                                           Deserializer &deserializer,
+                                           std::index_sequence<Is...>) {
+        // Plain function pointers, initialized at compile time.
+        using Case = std::variant<Types...> (*)(Deserializer &);
+        static constexpr Case cases[] = {
+            &deserialize_case<Is, Deserializer>...};
+        return cases[index](deserializer);
+    }
+};
+
+// --- Derivation of Skippable for composite types ---
+
+// string
+template <typename Allocator>
+struct Skippable<std::basic_string<char, std::char_traits<char>, Allocator>> {
+    template <typename Deserializer>
+    static void skip(Deserializer &deserializer) {
+        deserializer.skip_str();
+    }
+};
+
+// Value pointers
+template <typename T, typename Allocator>
+struct Skippable<value_ptr<T, Allocator>> {
+    template <typename Deserializer>
+    static void skip(Deserializer &deserializer) {
+        if (!deserializer.has_failed()) {
+            Skippable<T>::skip(deserializer);
+        }
+    }
+};
+
+// Options
+template <typename T>
+struct Skippable<std::optional<T>> {
+    template <typename Deserializer>
+    static void skip(Deserializer &deserializer) {
+        if (deserializer.deserialize_option_tag()) {
+            Skippable<T>::skip(deserializer);
+        }
+    }
+};
+
+// Vectors
+template <typename T, typename Allocator>
+struct Skippable<std::vector<T, Allocator>> {
+    template <typename Deserializer>
+    static void skip(Deserializer &deserializer) {
+        size_t len = deserializer.deserialize_len();
+        if constexpr (Deserializer::template is_bulk_copyable<T>) {
+            if (len > SIZE_MAX / sizeof(T)) {
+                deserializer.fail(deserialization_errc::length_too_large);
+                return;
+            }
+            if (can_copy_in_bulk<T>(deserializer)) {
+                deserializer.deserialize_raw_bytes(len * sizeof(T));
+                return;
+            }
+        }
+        for (size_t i = 0; i < len && !deserializer.has_failed(); i++) {
+            Skippable<T>::skip(deserializer);
+        }
+    }
+};
+
+// Maps (see `SerializableMap`)
+template <typename Map>
+struct SkippableMap {
+    template <typename Deserializer>
+    static void skip(Deserializer &deserializer) {
+        using K = typename Map::key_type;
+        using V = typename Map::mapped_type;
+        size_t len = deserializer.deserialize_len();
+        std::optional<std::tuple<size_t, size_t>> previous_key_slice;
+        if constexpr (Deserializer::enforce_strict_map_ordering) {
+            deserializer.begin_map_entries();
+        }
+        for (size_t i = 0; i < len && !deserializer.has_failed(); i++) {
+            auto start = deserializer.get_buffer_offset();
+            Skippable<K>::skip(deserializer);
+            check_map_key(deserializer, previous_key_slice, start);
+            Skippable<V>::skip(deserializer);
+        }
+        if constexpr (Deserializer::enforce_strict_map_ordering) {
+            deserializer.end_map_entries();
+        }
+    }
+};
+
+template <typename K, typename V, typename Compare, typename Allocator>
+struct Skippable<std::map<K, V, Compare, Allocator>>
+    : SkippableMap<std::map<K, V, Compare, Allocator>> {};
+
+template <typename K, typename V, typename Hash, typename Equal,
+          typename Allocator>
+struct Skippable<std::unordered_map<K, V, Hash, Equal, Allocator>>
+    : SkippableMap<std::unordered_map<K, V, Hash, Equal, Allocator>> {};
+
+template <typename K, typename V, typename Compare, typename Allocator>
+struct Skippable<flat_map<K, V, Compare, Allocator>>
+    : SkippableMap<flat_map<K, V, Compare, Allocator>> {};
+
+// Fixed-size arrays
+template <typename T, std::size_t N>
+struct Skippable<std::array<T, N>> {
+    template <typename Deserializer>
+    static void skip(Deserializer &deserializer) {
+        if constexpr (Deserializer::template is_bulk_copyable<T>) {
+            if (can_copy_in_bulk<T>(deserializer)) {
+                deserializer.deserialize_raw_bytes(N * sizeof(T));
+                return;
+            }
+        }
+        for (size_t i = 0; i < N; i++) {
+            Skippable<T>::skip(deserializer);
+        }
+    }
+};
+
+// Tuples
+template <class... Types>
+struct Skippable<std::tuple<Types...>> {
+    template <typename Deserializer>
+    static void skip(Deserializer &deserializer) {
+        (Skippable<Types>::skip(deserializer), ...);
+    }
+};
+
+// Enums
+template <class... Types>
+struct Skippable<std::variant<Types...>> {
+    template <typename Deserializer>
+    static void skip(Deserializer &deserializer) {
+        auto index = deserializer.deserialize_variant_index();
+        if (index >= sizeof...(Types)) {
+            deserializer.fail(deserialization_errc::unknown_variant_index);
+            return;
+        }
+        using Case = void (*)(Deserializer &);
+        static constexpr Case cases[] = {
+            &Skippable<Types>::template skip<Deserializer>...};
+        cases[index](deserializer);
+    }
+};
+
+// --- Derivation of DeserializableInto for composite types ---
+
+// After an error, values are left in a valid but unspecified state.
+
+// string
+template <typename Allocator>
+struct DeserializableInto<
+    std::basic_string<char, std::char_traits<char>, Allocator>> {
+    template <typename Deserializer>
+    static void deserialize_into(
+        std::basic_string<char, std::char_traits<char>, Allocator> &value,
+        Deserializer &deserializer) {
+        deserializer.deserialize_str_into(value);
+    }
+};
+
+// Value pointers
+template <typename T, typename Allocator>
+struct DeserializableInto<value_ptr<T, Allocator>> {
+    template <typename Deserializer>
+    static void deserialize_into(value_ptr<T, Allocator> &value,
+                                 Deserializer &deserializer) {
+        // After an error, stop following (possibly recursive) pointers.
+        if (deserializer.has_failed()) {
+            return;
+        }
+        if (value) {
+            DeserializableInto<T>::deserialize_into(*value, deserializer);
+        } else {
+            value = Deserializable<value_ptr<T, Allocator>>::deserialize(
+                deserializer);
+        }
+    }
+};
+
+// Options
+template <typename T>
+struct DeserializableInto<std::optional<T>> {
+    template <typename Deserializer>
+    static void deserialize_into(std::optional<T> &value,
+                                 Deserializer &deserializer) {
+        if (!deserializer.deserialize_option_tag()) {
+            value.reset();
+        } else if (value.has_value()) {
+            DeserializableInto<T>::deserialize_into(*value, deserializer);
+        } else {
+            value.emplace(Deserializable<T>::deserialize(deserializer));
+        }
+    }
+};
+
+// Vectors
+template <typename T, typename Allocator>
+struct DeserializableInto<std::vector<T, Allocator>> {
+    template <typename Deserializer>
+    static void deserialize_into(std::vector<T, Allocator> &value,
+                                 Deserializer &deserializer) {
+        size_t len = deserializer.deserialize_len();
+        if constexpr (Deserializer::template is_bulk_copyable<T>) {
+            if (len > SIZE_MAX / sizeof(T)) {
+                deserializer.fail(deserialization_errc::length_too_large);
+                value.clear();
+                return;
+            }
+            if (can_copy_in_bulk<T>(deserializer)) {
+                auto bytes =
+                    deserializer.deserialize_raw_bytes(len * sizeof(T));
+                if (bytes == nullptr) {
+                    value.clear();
+                    return;
+                }
+                SERDE_COUNT(allocations, len > value.capacity());
+                value.resize(len);
+                if (len > 0) {
+                    std::memcpy(value.data(), bytes, len * sizeof(T));
+                }
+                return;
+            }
+        }
+        if (deserializer.should_decode_in_parallel(len)) {
+            value.clear();
+            deserializer.deserialize_elements_in_parallel(value, len);
+            return;
+        }
+        // Decode into the existing elements first.
+        size_t i = 0;
+        for (; i < len && i < value.size() && !deserializer.has_failed(); i++) {
+            DeserializableInto<T>::deserialize_into(value[i], deserializer);
+        }
+        if (i < len && i == value.size()) {
+            size_t capacity =
+                i + bounded_capacity<T>(len - i,
+                                        deserializer.get_remaining_bytes());
+            SERDE_COUNT(allocations, capacity > value.capacity());
+            value.reserve(capacity);
+            for (; i < len && !deserializer.has_failed(); i++) {
+                value.emplace_back(
+                    Deserializable<T>::deserialize(deserializer));
+            }
+        }
+        value.erase(value.begin() + i, value.end());
+    }
+};
+
+// Maps with node-based storage (see `SerializableMap`)
+template <typename Map>
+struct DeserializableIntoMap {
+    template <typename Deserializer>
+    static void deserialize_into(Map &value, Deserializer &deserializer) {
+        using K = typename Map::key_type;
+        using V = typename Map::mapped_type;
+        // The nodes of the previous entries are reused for the new ones.
+        Map spare(value.get_allocator());
+        spare.swap(value);
+        size_t len = deserializer.deserialize_len();
+        std::optional<std::tuple<size_t, size_t>> previous_key_slice;
+        if constexpr (Deserializer::enforce_strict_map_ordering) {
+            deserializer.begin_map_entries();
+        }
+        for (size_t i = 0; i < len && !deserializer.has_failed(); i++) {
+            auto start = deserializer.get_buffer_offset();
+            auto node = spare.empty() ? typename Map::node_type()
+                                      : spare.extract(spare.begin());
+            if (node.empty()) {
+                auto key = Deserializable<K>::deserialize(deserializer);
+                check_map_key(deserializer, previous_key_slice, start);
+                auto mapped = Deserializable<V>::deserialize(deserializer);
+                value.emplace_hint(value.end(), std::move(key),
+                                   std::move(mapped));
+                SERDE_COUNT(allocations, 1);
+            } else {
+                DeserializableInto<K>::deserialize_into(node.key(),
+                                                        deserializer);
+                check_map_key(deserializer, previous_key_slice, start);
+                DeserializableInto<V>::deserialize_into(node.mapped(),
+                                                        deserializer);
+                value.insert(value.end(), std::move(node));
+            }
+        }
+        if constexpr (Deserializer::enforce_strict_map_ordering) {
+            deserializer.end_map_entries();
+        }
+    }
+};
+
+template <typename K, typename V, typename Compare, typename Allocator>
+struct DeserializableInto<std::map<K, V, Compare, Allocator>>
+    : DeserializableIntoMap<std::map<K, V, Compare, Allocator>> {};
+
+template <typename K, typename V, typename Hash, typename Equal,
+          typename Allocator>
+struct DeserializableInto<std::unordered_map<K, V, Hash, Equal, Allocator>>
+    : DeserializableIntoMap<std::unordered_map<K, V, Hash, Equal, Allocator>> {
+};
+
+// Flat maps reuse their entries, then sort them once.
+template <typename K, typename V, typename Compare, typename Allocator>
+struct DeserializableInto<flat_map<K, V, Compare, Allocator>> {
+    template <typename Deserializer>
+    static void deserialize_into(flat_map<K, V, Compare, Allocator> &value,
+                                 Deserializer &deserializer) {
+        auto entries = std::move(value).extract();
+        size_t len = deserializer.deserialize_len();
+        std::optional<std::tuple<size_t, size_t>> previous_key_slice;
+        if constexpr (Deserializer::enforce_strict_map_ordering) {
+            deserializer.begin_map_entries();
+        }
+        size_t i = 0;
+        for (; i < len && !deserializer.has_failed(); i++) {
+            auto start = deserializer.get_buffer_offset();
+            if (i < entries.size()) {
+                DeserializableInto<K>::deserialize_into(entries[i].first,
+                                                        deserializer);
+                check_map_key(deserializer, previous_key_slice, start);
+                DeserializableInto<V>::deserialize_into(entries[i].second,
+                                                        deserializer);
+            } else {
+                if (i == entries.capacity()) {
+                    SERDE_COUNT(allocations, 1);
+                    entries.reserve(
+                        i + bounded_capacity<std::tuple<K, V>>(
+                                len - i, deserializer.get_remaining_bytes()));
+                }
+                auto key = Deserializable<K>::deserialize(deserializer);
+                check_map_key(deserializer, previous_key_slice, start);
+                auto mapped = Deserializable<V>::deserialize(deserializer);
+                entries.emplace_back(std::move(key), std::move(mapped));
+            }
+        }
+        entries.erase(entries.begin() + std::min(i, entries.size()),
+                      entries.end());
+        if constexpr (Deserializer::enforce_strict_map_ordering) {
+            deserializer.end_map_entries();
+        }
+        value.replace(std::move(entries));
+    }
+};
+
+// Fixed-size arrays
+template <typename T, std::size_t N>
+struct DeserializableInto<std::array<T, N>> {
+    template <typename Deserializer>
+    static void deserialize_into(std::array<T, N> &value,
+                                 Deserializer &deserializer) {
+        if constexpr (Deserializer::template is_bulk_copyable<T>) {
+            if (can_copy_in_bulk<T>(deserializer)) {
+                auto bytes = deserializer.deserialize_raw_bytes(N * sizeof(T));
+                if (bytes != nullptr) {
+                    std::memcpy(value.data(), bytes, N * sizeof(T));
+                }
+                return;
+            }
+        }
+        for (auto &item : value) {
+            DeserializableInto<T>::deserialize_into(item, deserializer);
+        }
+    }
+};
+
+// Tuples
+template <class... Types>
+struct DeserializableInto<std::tuple<Types...>> {
+    template <typename Deserializer>
+    static void deserialize_into(std::tuple<Types...> &value,
+                                 Deserializer &deserializer) {
+        std::apply(
+            [&](Types &... items) {
+                (DeserializableInto<Types>::deserialize_into(items,
+                                                             deserializer),
+                 ...);
+            },
+            value);
+    }
+};
+
+// Enums
+template <class... Types>
+struct DeserializableInto<std::variant<Types...>> {
+    template <typename Deserializer>
+    static void deserialize_into(std::variant<Types...> &value,
+                                 Deserializer &deserializer) {
+        auto index = deserializer.deserialize_variant_index();
+        if (index >= sizeof...(Types)) {
+            deserializer.fail(deserialization_errc::unknown_variant_index);
+            return;
         }
-        return cases.at(index)(deserializer);
+        dispatch(index, value, deserializer,
+                 std::index_sequence_for<Types...>{});
+    }
+
+  private:
+    // Decode into the current alternative when it has the right index.
+    template <size_t I, typename Deserializer>
+    static void deserialize_case(std::variant<Types...> &value,
+                                 Deserializer &deserializer) {
+        using T = std::variant_alternative_t<I, std::variant<Types...>>;
+        if (value.index() == I) {
+            DeserializableInto<T>::deserialize_into(std::get<I>(value),
+                                                    deserializer);
+        } else {
+            value.template emplace<I>(
+                Deserializable<T>::deserialize(deserializer));
+        }
+    }
+
+    template <typename Deserializer, size_t... Is>
+    static void dispatch(size_t index, std::variant<Types...> &value,
+                         Deserializer &deserializer,
+                         std::index_sequence<Is...>) {
+        using Case = void (*)(std::variant<Types...> &, Deserializer &);
+        static constexpr Case cases[] = {
+            &deserialize_case<Is, Deserializer>...};
+        cases[index](value, deserializer);
     }
 };
 
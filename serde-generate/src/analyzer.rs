@@ -1,7 +1,7 @@
 // Copyright (c) Facebook, Inc. and its affiliates
 // SPDX-License-Identifier: MIT OR Apache-2.0
 
-use serde_reflection::{ContainerFormat, Format, FormatHolder, Registry, Result};
+use serde_reflection::{ContainerFormat, Format, FormatHolder, Registry, Result, VariantFormat};
 use std::collections::{BTreeMap, BTreeSet, HashSet};
 
 /// Compute dependencies while ignoring external names.
@@ -42,6 +42,108 @@ pub fn get_dependency_map_with_external_dependencies<'a>(
     Ok(children)
 }
 
+/// Build a map of the dependencies that determine the size of values, i.e. the references
+/// that are not nested in a `Format::Seq`.
+/// * Vectors store their elements out of line and may be declared with incomplete element types
+/// in C++. Ignoring them, the remaining cycles are exactly those that require boxing.
+pub fn get_size_dependency_map(registry: &Registry) -> BTreeMap<&str, BTreeSet<&str>> {
+    fn visit<'a>(format: &'a Format, result: &mut BTreeSet<&'a str>) {
+        use Format::*;
+        match format {
+            TypeName(x) => {
+                result.insert(x.as_str());
+            }
+            Option(format) => visit(format, result),
+            Map { key, value } => {
+                visit(key, result);
+                visit(value, result);
+            }
+            Tuple(formats) => formats.iter().for_each(|format| visit(format, result)),
+            TupleArray { content, size: _ } => visit(content, result),
+            _ => (),
+        }
+    }
+
+    let mut children = BTreeMap::new();
+    for (name, format) in registry {
+        let mut result = BTreeSet::new();
+        match format {
+            ContainerFormat::UnitStruct => (),
+            ContainerFormat::NewTypeStruct(format) => visit(format, &mut result),
+            ContainerFormat::TupleStruct(formats) => {
+                formats.iter().for_each(|format| visit(format, &mut result))
+            }
+            ContainerFormat::Struct(fields) => fields
+                .iter()
+                .for_each(|field| visit(&field.value, &mut result)),
+            ContainerFormat::Enum(variants) => {
+                for variant in variants.values() {
+                    match &variant.value {
+                        VariantFormat::Unit | VariantFormat::Variable(_) => (),
+                        VariantFormat::NewType(format) => visit(format, &mut result),
+                        VariantFormat::Tuple(formats) => {
+                            formats.iter().for_each(|format| visit(format, &mut result))
+                        }
+                        VariantFormat::Struct(fields) => fields
+                            .iter()
+                            .for_each(|field| visit(&field.value, &mut result)),
+                    }
+                }
+            }
+        }
+        children.insert(name.as_str(), result);
+    }
+    children
+}
+
+/// Compute the maximal number of nested containers in the values of each entry of a dependency
+/// map, counting the entry itself.
+/// * The result is `None` for entries that may nest containers arbitrarily deep, i.e. entries
+/// that depend on themselves (directly or not) or on names missing from the map.
+/// * Languages that track the depth of containers at runtime (e.g. C++) may use this to skip the
+/// tracking of entries whose values are always shallow enough.
+pub fn get_max_depths<T>(children: &BTreeMap<T, BTreeSet<T>>) -> BTreeMap<T, Option<usize>>
+where
+    T: Clone + std::cmp::Ord + std::cmp::Eq,
+{
+    fn visit<T>(
+        node: &T,
+        children: &BTreeMap<T, BTreeSet<T>>,
+        depths: &mut BTreeMap<T, Option<usize>>,
+        visiting: &mut BTreeSet<T>,
+    ) -> Option<usize>
+    where
+        T: Clone + std::cmp::Ord + std::cmp::Eq,
+    {
+        if let Some(depth) = depths.get(node) {
+            return *depth;
+        }
+        let node_children = children.get(node)?;
+        // Nodes on the current path reached again belong to a cycle. Results stored below are
+        // still exact: a node reaching a node of the current path belongs to a cycle too.
+        if !visiting.insert(node.clone()) {
+            return None;
+        }
+        let mut depth = Some(1);
+        for child in node_children {
+            depth = match (depth, visit(child, children, depths, visiting)) {
+                (Some(depth), Some(child_depth)) => Some(std::cmp::max(depth, child_depth + 1)),
+                _ => None,
+            };
+        }
+        visiting.remove(node);
+        depths.insert(node.clone(), depth);
+        depth
+    }
+
+    let mut depths = BTreeMap::new();
+    let mut visiting = BTreeSet::new();
+    for node in children.keys() {
+        visit(node, children, &mut depths, &mut visiting);
+    }
+    depths
+}
+
 /// Classic topological sorting algorithm except that it doesn't abort in case of cycles.
 pub fn best_effort_topological_sort<T>(children: &BTreeMap<T, BTreeSet<T>>) -> Vec<T>
 where
@@ -13,12 +13,41 @@ pub struct CodeGeneratorConfig {
     pub(crate) comments: DocComments,
     pub(crate) custom_code: CustomCode,
     pub(crate) c_style_enums: bool,
+    pub(crate) polymorphic_allocators: bool,
+    pub(crate) views: bool,
+    pub(crate) map_representation: MapRepresentation,
 }
 
 #[derive(Clone, Copy, Debug, PartialOrd, Ord, PartialEq, Eq)]
 pub enum Encoding {
     Bincode,
     Bcs,
+    /// Bincode with variable-length integers, lengths and variant indices, as configured by
+    /// `bincode::options()` in Rust. Only supported in C++ (ignored by other languages).
+    BincodeVarint,
+    /// Bincode with big-endian integers, as configured by
+    /// `bincode::options().with_fixint_encoding().with_big_endian()` in Rust. Only supported in
+    /// C++ (ignored by other languages).
+    BincodeBigEndian,
+    /// Bincode with variable-length integers and big-endian fixed-width values, as configured
+    /// by `bincode::options().with_big_endian()` in Rust. Only supported in C++ (ignored by
+    /// other languages).
+    BincodeVarintBigEndian,
+}
+
+/// How generated code stores maps, in languages that offer a choice.
+#[derive(Clone, Debug, PartialEq, Eq)]
+pub enum MapRepresentation {
+    /// Ordered tree (e.g. `std::map` in C++).
+    Ordered,
+    /// Vector of entries sorted by key (e.g. `serde::flat_map` in C++): contiguous storage and
+    /// logarithmic lookups, but linear insertions.
+    Flat,
+    /// Hash table (e.g. `std::unordered_map` in C++).
+    Hashed,
+    /// User-supplied template taking the key and value types (e.g. `absl::btree_map` in C++).
+    /// The serialization traits of the template must be provided by the user.
+    Custom(String),
 }
 
 /// Track types definitions provided by external modules.
@@ -67,6 +96,9 @@ impl CodeGeneratorConfig {
             comments: BTreeMap::new(),
             custom_code: BTreeMap::new(),
             c_style_enums: false,
+            polymorphic_allocators: false,
+            views: false,
+            map_representation: MapRepresentation::Ordered,
         }
     }
 
@@ -117,6 +149,37 @@ impl CodeGeneratorConfig {
         self.c_style_enums = c_style_enums;
         self
     }
+
+    /// Allocate the memory of generated values through polymorphic allocators
+    /// (e.g. `std::pmr` in C++), so that values can be decoded into a custom
+    /// memory resource such as an arena. Ignored by languages that do not have
+    /// such allocators.
+    pub fn with_polymorphic_allocators(mut self, polymorphic_allocators: bool) -> Self {
+        self.polymorphic_allocators = polymorphic_allocators;
+        self
+    }
+
+    /// Generate read-only views that decode the fields of encoded values on
+    /// access, in supported languages.
+    pub fn with_views(mut self, views: bool) -> Self {
+        self.views = views;
+        self
+    }
+
+    /// How to store maps in generated values (by default, as ordered trees). Ignored by
+    /// languages that do not offer a choice.
+    pub fn with_map_representation(mut self, map_representation: MapRepresentation) -> Self {
+        self.map_representation = map_representation;
+        self
+    }
+
+    /// Encodings requested for languages that only support the default configurations of
+    /// Bincode and BCS.
+    pub(crate) fn default_encodings(&self) -> impl Iterator<Item = &Encoding> {
+        self.encodings
+            .iter()
+            .filter(|encoding| matches!(encoding, Encoding::Bincode | Encoding::Bcs))
+    }
 }
 
 impl Encoding {
@@ -124,6 +187,9 @@ impl Encoding {
         match self {
             Encoding::Bincode => "bincode",
             Encoding::Bcs => "bcs",
+            Encoding::BincodeVarint => "bincode_varint",
+            Encoding::BincodeBigEndian => "bincode_big_endian",
+            Encoding::BincodeVarintBigEndian => "bincode_varint_big_endian",
         }
     }
 }
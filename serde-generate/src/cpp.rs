@@ -4,14 +4,21 @@
 use crate::{
     analyzer,
     indent::{IndentConfig, IndentedWriter},
-    CodeGeneratorConfig, Encoding,
+    CodeGeneratorConfig, Encoding, MapRepresentation,
 };
-use heck::CamelCase;
+use heck::{CamelCase, MixedCase};
 use serde_reflection::{ContainerFormat, Format, Named, Registry, VariantFormat};
 use std::collections::{BTreeMap, HashMap, HashSet};
 use std::io::{Result, Write};
 use std::path::PathBuf;
 
+/// Decode the in-memory representation of a struct into `obj`. (A failed read leaves `obj`
+/// unchanged after recording an error.)
+const MEMCPY_DESERIALIZE_INTO_OBJ: &str = r#"auto bytes = deserializer.deserialize_raw_bytes(sizeof(obj));
+if (bytes != nullptr) {
+    std::memcpy(&obj, bytes, sizeof(obj));
+}"#;
+
 /// Main configuration object for code-generation in C++.
 pub struct CodeGenerator<'a> {
     /// Language-independent configuration.
@@ -33,6 +40,23 @@ struct CppEmitter<'a, T> {
     known_sizes: HashSet<&'a str>,
     /// Current namespace (e.g. vec!["name", "MyClass"])
     current_namespace: Vec<String>,
+    /// Maximal number of nested containers in the values of each definition, if bounded.
+    max_depths: BTreeMap<String, Option<usize>>,
+    /// Definitions made only of fixed-width integers, which may be (de)serialized with a single
+    /// memcpy. (Whether their C++ layout allows it is checked by `serde::MemcpyLayout`.)
+    memcpy_layouts: HashSet<String>,
+}
+
+/// How generated code tracks the depth of nested containers.
+#[derive(Clone, Copy)]
+enum DepthTracking {
+    /// Not a container (e.g. a variant of an enum).
+    Untracked,
+    /// A container whose values nest at most the given number of containers. Tracking is only
+    /// needed when the remaining depth budget is smaller.
+    Bounded(usize),
+    /// A (recursive) container whose values may nest containers arbitrarily deep.
+    Unbounded,
 }
 
 impl<'a> CodeGenerator<'a> {
@@ -65,21 +89,35 @@ impl<'a> CodeGenerator<'a> {
             .split("::")
             .map(String::from)
             .collect();
+        let dependencies = analyzer::get_dependency_map(registry)?;
+        let max_depths = analyzer::get_max_depths(&dependencies)
+            .into_iter()
+            .map(|(name, depth)| (name.to_string(), depth))
+            .collect();
+        let memcpy_layouts = registry
+            .iter()
+            .filter(|(_, format)| Self::has_memcpy_layout(format, registry))
+            .map(|(name, _)| name.clone())
+            .collect();
         let mut emitter = CppEmitter {
             out: IndentedWriter::new(out, IndentConfig::Space(4)),
             generator: self,
             known_names: HashSet::new(),
             known_sizes: HashSet::new(),
             current_namespace,
+            max_depths,
+            memcpy_layouts,
         };
 
         emitter.output_preamble()?;
         emitter.output_open_namespace()?;
 
-        let dependencies = analyzer::get_dependency_map(registry)?;
-        let entries = analyzer::best_effort_topological_sort(&dependencies);
+        // Only references that determine the size of values need to be defined first. Breaking
+        // the remaining cycles, if any, requires boxing.
+        let entries =
+            analyzer::best_effort_topological_sort(&analyzer::get_size_dependency_map(registry));
 
-        for name in entries {
+        for &name in &entries {
             for dependency in &dependencies[name] {
                 if !emitter.known_names.contains(dependency) {
                     emitter.output_container_forward_definition(*dependency)?;
@@ -94,11 +132,60 @@ impl<'a> CodeGenerator<'a> {
 
         emitter.output_close_namespace()?;
         writeln!(emitter.out)?;
+        if self.config.serialization {
+            // Static sizes of containers are derived from the sizes of their
+            // fields, hence must follow the dependency order.
+            for &name in &entries {
+                emitter.output_container_encoded_size(name, &registry[name])?;
+                emitter.output_container_memcpy_layout(name, &registry[name])?;
+            }
+        }
         for (name, format) in registry {
             emitter.output_container_traits(&name, format)?;
         }
+        if self.config.serialization && self.config.views {
+            emitter.output_open_namespace()?;
+            for name in registry.keys() {
+                writeln!(emitter.out)?;
+                emitter.output_view_forward_definition(name)?;
+            }
+            for (name, format) in registry {
+                emitter.output_container_view(name, format)?;
+            }
+            emitter.output_close_namespace()?;
+        }
         Ok(())
     }
+
+    /// Whether the encoding of a container may be its in-memory representation, i.e. it is a
+    /// struct of fixed-width integers, of arrays of them, or of other such structs.
+    fn has_memcpy_layout(format: &ContainerFormat, registry: &Registry) -> bool {
+        use ContainerFormat::*;
+        match format {
+            NewTypeStruct(format) => Self::has_memcpy_format(format, registry),
+            Struct(fields) => {
+                !fields.is_empty()
+                    && fields
+                        .iter()
+                        .all(|field| Self::has_memcpy_format(&field.value, registry))
+            }
+            // Tuples are not laid out in order and variants have no fixed size.
+            UnitStruct | TupleStruct(_) | Enum(_) => false,
+        }
+    }
+
+    fn has_memcpy_format(format: &Format, registry: &Registry) -> bool {
+        use Format::*;
+        match format {
+            U8 | U16 | U32 | U64 | I8 | I16 | I32 | I64 => true,
+            TupleArray { content, size: _ } => Self::has_memcpy_format(content, registry),
+            TypeName(name) => match registry.get(name) {
+                Some(format) => Self::has_memcpy_layout(format, registry),
+                None => false,
+            },
+            _ => false,
+        }
+    }
 }
 
 impl<'a, T> CppEmitter<'a, T>
@@ -112,9 +199,21 @@ where
 
 #include "serde.hpp""#
         )?;
+        if self.generator.config.polymorphic_allocators {
+            writeln!(self.out, "#include <memory_resource>")?;
+        }
         if self.generator.config.serialization {
+            // All the configurations of Bincode share the same header.
+            let mut headers = Vec::new();
             for encoding in &self.generator.config.encodings {
-                writeln!(self.out, "#include \"{}.hpp\"", encoding.name())?;
+                let header = match encoding {
+                    Encoding::Bcs => "bcs",
+                    _ => "bincode",
+                };
+                if !headers.contains(&header) {
+                    writeln!(self.out, "#include \"{}.hpp\"", header)?;
+                    headers.push(header);
+                }
             }
         }
         Ok(())
@@ -181,6 +280,24 @@ where
             .unwrap_or_else(|| format!("{}::{}", self.generator.config.module_name, name))
     }
 
+    /// Namespace of the standard containers used in definitions.
+    fn std_namespace(&self) -> &'static str {
+        if self.generator.config.polymorphic_allocators {
+            "std::pmr"
+        } else {
+            "std"
+        }
+    }
+
+    /// Namespace of the Serde containers used in definitions.
+    fn serde_namespace(&self) -> &'static str {
+        if self.generator.config.polymorphic_allocators {
+            "serde::pmr"
+        } else {
+            "serde"
+        }
+    }
+
     fn quote_type(&self, format: &Format, require_known_size: bool) -> String {
         use Format::*;
         match format {
@@ -189,7 +306,7 @@ where
                 if require_known_size && !self.known_sizes.contains(x.as_str()) {
                     // Cannot use unique_ptr because we need a copy constructor (e.g. for vectors)
                     // and in-depth equality.
-                    format!("serde::value_ptr<{}>", qname)
+                    format!("{}::value_ptr<{}>", self.serde_namespace(), qname)
                 } else {
                     qname
                 }
@@ -209,19 +326,39 @@ where
             F32 => "float".into(),
             F64 => "double".into(),
             Char => "char32_t".into(),
-            Str => "std::string".into(),
-            Bytes => "std::vector<uint8_t>".into(),
+            Str => format!("{}::string", self.std_namespace()),
+            Bytes => format!("{}::vector<uint8_t>", self.std_namespace()),
 
             Option(format) => format!(
                 "std::optional<{}>",
                 self.quote_type(format, require_known_size)
             ),
-            Seq(format) => format!("std::vector<{}>", self.quote_type(format, false)),
-            Map { key, value } => format!(
-                "std::map<{}, {}>",
-                self.quote_type(key, false),
-                self.quote_type(value, false)
+            Seq(format) => format!(
+                "{}::vector<{}>",
+                self.std_namespace(),
+                self.quote_type(format, false)
             ),
+            Map { key, value } => {
+                let key = self.quote_type(key, false);
+                let value = self.quote_type(value, false);
+                match &self.generator.config.map_representation {
+                    MapRepresentation::Ordered => {
+                        format!("{}::map<{}, {}>", self.std_namespace(), key, value)
+                    }
+                    MapRepresentation::Flat => {
+                        format!("{}::flat_map<{}, {}>", self.serde_namespace(), key, value)
+                    }
+                    MapRepresentation::Hashed => format!(
+                        "{}::unordered_map<{1}, {2}, serde::hash<{1}>>",
+                        self.std_namespace(),
+                        key,
+                        value
+                    ),
+                    MapRepresentation::Custom(template) => {
+                        format!("{}<{}, {}>", template, key, value)
+                    }
+                }
+            }
             Tuple(formats) => format!(
                 "std::tuple<{}>",
                 self.quote_types(formats, require_known_size)
@@ -328,18 +465,68 @@ where
             "friend bool operator==(const {}&, const {}&);",
             name, name
         )?;
+        if self.generator.config.map_representation == MapRepresentation::Hashed {
+            writeln!(self.out, "friend size_t hash_value(const {}&);", name)?;
+        }
         if self.generator.config.serialization {
             for encoding in &self.generator.config.encodings {
                 writeln!(
                     self.out,
                     "std::vector<uint8_t> {}Serialize() const;",
-                    encoding.name()
+                    encoding.name().to_mixed_case()
+                )?;
+                writeln!(
+                    self.out,
+                    "void {}Serialize(std::vector<uint8_t> &) const;",
+                    encoding.name().to_mixed_case()
                 )?;
                 writeln!(
                     self.out,
-                    "static {} {}Deserialize(std::vector<uint8_t>);",
+                    "size_t {}Serialize(uint8_t *, size_t) const;",
+                    encoding.name().to_mixed_case()
+                )?;
+                let resource = if self.generator.config.polymorphic_allocators {
+                    ", std::pmr::memory_resource * = std::pmr::get_default_resource()"
+                } else {
+                    ""
+                };
+                writeln!(
+                    self.out,
+                    "static {} {}Deserialize(const std::vector<uint8_t> &{});",
+                    name,
+                    encoding.name().to_mixed_case(),
+                    resource
+                )?;
+                writeln!(
+                    self.out,
+                    "static {} {}Deserialize(const uint8_t *, size_t{});",
                     name,
-                    encoding.name()
+                    encoding.name().to_mixed_case(),
+                    resource
+                )?;
+                writeln!(
+                    self.out,
+                    "static serde::deserialization_result<{}> {}TryDeserialize(const uint8_t *, size_t{});",
+                    name,
+                    encoding.name().to_mixed_case(),
+                    resource
+                )?;
+                writeln!(
+                    self.out,
+                    "void {}DeserializeInto(const std::vector<uint8_t> &{});",
+                    encoding.name().to_mixed_case(),
+                    resource
+                )?;
+                writeln!(
+                    self.out,
+                    "void {}DeserializeInto(const uint8_t *, size_t{});",
+                    encoding.name().to_mixed_case(),
+                    resource
+                )?;
+                writeln!(
+                    self.out,
+                    "static size_t {}Validate(const uint8_t *, size_t);",
+                    encoding.name().to_mixed_case()
                 )?;
             }
         }
@@ -386,6 +573,20 @@ where
         writeln!(self.out, "}}")
     }
 
+    /// Hash function of the keys of hash maps (see `serde::hash`).
+    fn output_struct_hash_value(&mut self, name: &str, fields: &[&str]) -> Result<()> {
+        writeln!(
+            self.out,
+            "\ninline size_t hash_value(const {} &obj) {{\n    return serde::hash_values({});\n}}",
+            name,
+            fields
+                .iter()
+                .map(|field| format!("obj.{}", field))
+                .collect::<Vec<_>>()
+                .join(", "),
+        )
+    }
+
     fn output_struct_serialize_for_encoding(
         &mut self,
         name: &str,
@@ -394,15 +595,27 @@ where
         writeln!(
             self.out,
             r#"
-inline std::vector<uint8_t> {}::{}Serialize() const {{
-    auto serializer = serde::{}Serializer();
-    serde::Serializable<{}>::serialize(*this, serializer);
+inline std::vector<uint8_t> {0}::{1}Serialize() const {{
+    auto serializer = serde::{2}Serializer();
+    serializer.reserve(serde::{2}Serializer::serialized_size(*this));
+    serde::Serializable<{0}>::serialize(*this, serializer);
     return std::move(serializer).bytes();
+}}
+
+inline void {0}::{1}Serialize(std::vector<uint8_t> &output) const {{
+    output.clear();
+    auto serializer = serde::Basic{2}Serializer<serde::VectorRefOutput>(output);
+    serde::Serializable<{0}>::serialize(*this, serializer);
+}}
+
+inline size_t {0}::{1}Serialize(uint8_t *buffer, size_t capacity) const {{
+    auto serializer = serde::Basic{2}Serializer<serde::BufferOutput>({{buffer, capacity}});
+    serde::Serializable<{0}>::serialize(*this, serializer);
+    return serializer.get_buffer_offset();
 }}"#,
             name,
-            encoding.name(),
+            encoding.name().to_mixed_case(),
             encoding.name().to_camel_case(),
-            name
         )
     }
 
@@ -411,30 +624,192 @@ inline std::vector<uint8_t> {}::{}Serialize() const {{
         name: &str,
         encoding: Encoding,
     ) -> Result<()> {
+        if self.generator.config.polymorphic_allocators {
+            return writeln!(
+                self.out,
+                r#"
+inline {0} {0}::{1}Deserialize(const std::vector<uint8_t> &input, std::pmr::memory_resource *resource) {{
+    return {1}Deserialize(input.data(), input.size(), resource);
+}}
+
+inline {0} {0}::{1}Deserialize(const uint8_t *input, size_t size, std::pmr::memory_resource *resource) {{
+    auto deserializer = serde::{2}Deserializer(input, size);
+    deserializer.set_memory_resource(resource);
+    auto value = serde::Deserializable<{0}>::deserialize(deserializer);
+    if (deserializer.get_buffer_offset() < size) {{
+        SERDE_THROW(serde::deserialization_error("Some input bytes were not read"));
+    }}
+    return value;
+}}
+
+inline serde::deserialization_result<{0}> {0}::{1}TryDeserialize(const uint8_t *input, size_t size, std::pmr::memory_resource *resource) {{
+    auto deserializer = serde::{2}Deserializer(input, size);
+    deserializer.set_throw_on_error(false);
+    deserializer.set_memory_resource(resource);
+    auto value = serde::Deserializable<{0}>::deserialize(deserializer);
+    if (deserializer.get_buffer_offset() < size) {{
+        deserializer.fail(serde::deserialization_errc::trailing_bytes);
+    }}
+    if (deserializer.has_failed()) {{
+        return deserializer.get_failure();
+    }}
+    return std::move(value);
+}}"#,
+                name,
+                encoding.name().to_mixed_case(),
+                encoding.name().to_camel_case(),
+            );
+        }
         writeln!(
             self.out,
             r#"
-inline {} {}::{}Deserialize(std::vector<uint8_t> input) {{
-    auto deserializer = serde::{}Deserializer(input);
-    auto value = serde::Deserializable<{}>::deserialize(deserializer);
-    if (deserializer.get_buffer_offset() < input.size()) {{
-        throw serde::deserialization_error("Some input bytes were not read");
+inline {0} {0}::{1}Deserialize(const std::vector<uint8_t> &input) {{
+    return {1}Deserialize(input.data(), input.size());
+}}
+
+inline {0} {0}::{1}Deserialize(const uint8_t *input, size_t size) {{
+    auto deserializer = serde::{2}Deserializer(input, size);
+    auto value = serde::Deserializable<{0}>::deserialize(deserializer);
+    if (deserializer.get_buffer_offset() < size) {{
+        SERDE_THROW(serde::deserialization_error("Some input bytes were not read"));
     }}
     return value;
+}}
+
+inline serde::deserialization_result<{0}> {0}::{1}TryDeserialize(const uint8_t *input, size_t size) {{
+    auto deserializer = serde::{2}Deserializer(input, size);
+    deserializer.set_throw_on_error(false);
+    auto value = serde::Deserializable<{0}>::deserialize(deserializer);
+    if (deserializer.get_buffer_offset() < size) {{
+        deserializer.fail(serde::deserialization_errc::trailing_bytes);
+    }}
+    if (deserializer.has_failed()) {{
+        return deserializer.get_failure();
+    }}
+    return std::move(value);
 }}"#,
             name,
+            encoding.name().to_mixed_case(),
+            encoding.name().to_camel_case(),
+        )
+    }
+
+    fn output_struct_deserialize_into_for_encoding(
+        &mut self,
+        name: &str,
+        encoding: Encoding,
+    ) -> Result<()> {
+        let (resource_param, resource_arg, set_resource) =
+            if self.generator.config.polymorphic_allocators {
+                (
+                    ", std::pmr::memory_resource *resource",
+                    ", resource",
+                    "\n    deserializer.set_memory_resource(resource);",
+                )
+            } else {
+                ("", "", "")
+            };
+        writeln!(
+            self.out,
+            r#"
+inline void {0}::{1}DeserializeInto(const std::vector<uint8_t> &input{3}) {{
+    {1}DeserializeInto(input.data(), input.size(){4});
+}}
+
+inline void {0}::{1}DeserializeInto(const uint8_t *input, size_t size{3}) {{
+    auto deserializer = serde::{2}Deserializer(input, size);{5}
+    serde::DeserializableInto<{0}>::deserialize_into(*this, deserializer);
+    if (deserializer.get_buffer_offset() < size) {{
+        SERDE_THROW(serde::deserialization_error("Some input bytes were not read"));
+    }}
+}}"#,
             name,
-            encoding.name(),
+            encoding.name().to_mixed_case(),
             encoding.name().to_camel_case(),
+            resource_param,
+            resource_arg,
+            set_resource,
+        )
+    }
+
+    fn output_struct_validate_for_encoding(
+        &mut self,
+        name: &str,
+        encoding: Encoding,
+    ) -> Result<()> {
+        writeln!(
+            self.out,
+            r#"
+inline size_t {0}::{1}Validate(const uint8_t *input, size_t size) {{
+    auto deserializer = serde::{2}Deserializer(input, size);
+    serde::Skippable<{0}>::skip(deserializer);
+    return deserializer.get_buffer_offset();
+}}"#,
             name,
+            encoding.name().to_mixed_case(),
+            encoding.name().to_camel_case(),
         )
     }
 
+    fn output_increase_container_depth(&mut self, var: &str, depth: DepthTracking) -> Result<()> {
+        use DepthTracking::*;
+        match depth {
+            Untracked => Ok(()),
+            Bounded(depth) => writeln!(
+                self.out,
+                "bool tracked = !{0}.has_container_depth_budget({1});\nif (tracked) {{ {0}.increase_container_depth(); }}",
+                var, depth,
+            ),
+            Unbounded => writeln!(self.out, "{}.increase_container_depth();", var),
+        }
+    }
+
+    fn output_decrease_container_depth(&mut self, var: &str, depth: DepthTracking) -> Result<()> {
+        use DepthTracking::*;
+        match depth {
+            Untracked => Ok(()),
+            Bounded(_) => writeln!(
+                self.out,
+                "if (tracked) {{ {}.decrease_container_depth(); }}",
+                var
+            ),
+            Unbounded => writeln!(self.out, "{}.decrease_container_depth();", var),
+        }
+    }
+
+    /// Copy the in-memory representation of a struct in one go, when `serde::MemcpyLayout`
+    /// allows it and the remaining depth budget covers the nested structs.
+    fn output_memcpy_fast_path(&mut self, var: &str, name: &str, body: &str) -> Result<()> {
+        writeln!(
+            self.out,
+            "if constexpr ({0}::template is_bulk_copyable<{1}>) {{",
+            if var == "serializer" {
+                "Serializer"
+            } else {
+                "Deserializer"
+            },
+            name,
+        )?;
+        self.out.indent();
+        writeln!(
+            self.out,
+            "if (serde::can_copy_in_bulk<{}>({})) {{",
+            name, var
+        )?;
+        self.out.indent();
+        writeln!(self.out, "{}", body)?;
+        self.out.unindent();
+        writeln!(self.out, "}}")?;
+        self.out.unindent();
+        writeln!(self.out, "}}")
+    }
+
     fn output_struct_serializable(
         &mut self,
         name: &str,
         fields: &[&str],
-        is_container: bool,
+        depth: DepthTracking,
+        has_memcpy_layout: bool,
     ) -> Result<()> {
         writeln!(
             self.out,
@@ -445,9 +820,15 @@ void serde::Serializable<{0}>::serialize(const {0} &obj, Serializer &serializer)
             name,
         )?;
         self.out.indent();
-        if is_container {
-            writeln!(self.out, "serializer.increase_container_depth();")?;
+        writeln!(self.out, "SERDE_TIME_TYPE(\"{}\", \"serialize\");", name)?;
+        if has_memcpy_layout {
+            self.output_memcpy_fast_path(
+                "serializer",
+                name,
+                "serializer.serialize_raw_bytes(reinterpret_cast<const uint8_t *>(&obj), sizeof(obj));\nreturn;",
+            )?;
         }
+        self.output_increase_container_depth("serializer", depth)?;
         for field in fields {
             writeln!(
                 self.out,
@@ -455,9 +836,7 @@ void serde::Serializable<{0}>::serialize(const {0} &obj, Serializer &serializer)
                 field,
             )?;
         }
-        if is_container {
-            writeln!(self.out, "serializer.decrease_container_depth();")?;
-        }
+        self.output_decrease_container_depth("serializer", depth)?;
         self.out.unindent();
         writeln!(self.out, "}}")
     }
@@ -466,7 +845,9 @@ void serde::Serializable<{0}>::serialize(const {0} &obj, Serializer &serializer)
         &mut self,
         name: &str,
         fields: &[&str],
-        is_container: bool,
+        depth: DepthTracking,
+        is_aggregate: bool,
+        has_memcpy_layout: bool,
     ) -> Result<()> {
         writeln!(
             self.out,
@@ -477,21 +858,129 @@ template <typename Deserializer>
             name,
         )?;
         self.out.indent();
-        if is_container {
-            writeln!(self.out, "deserializer.increase_container_depth();")?;
+        writeln!(self.out, "SERDE_TIME_TYPE(\"{}\", \"deserialize\");", name)?;
+        if has_memcpy_layout {
+            self.output_memcpy_fast_path(
+                "deserializer",
+                name,
+                &format!(
+                    "{} obj{{}};\n{}\nreturn obj;",
+                    name, MEMCPY_DESERIALIZE_INTO_OBJ
+                ),
+            )?;
+        }
+        self.output_increase_container_depth("deserializer", depth)?;
+        if is_aggregate && fields.is_empty() {
+            writeln!(self.out, "{} obj{{}};", name)?;
+        } else if is_aggregate {
+            // Fields are constructed in place (from left to right), keeping the
+            // allocators they were decoded with.
+            writeln!(self.out, "{} obj{{", name)?;
+            self.out.indent();
+            for field in fields {
+                writeln!(
+                    self.out,
+                    "serde::Deserializable<decltype({0}::{1})>::deserialize(deserializer),",
+                    name, field,
+                )?;
+            }
+            self.out.unindent();
+            writeln!(self.out, "}};")?;
+        } else {
+            // Fields are decoded into the default-constructed object, without
+            // temporaries.
+            writeln!(self.out, "{} obj;", name)?;
+            for field in fields {
+                writeln!(
+                    self.out,
+                    "serde::DeserializableInto<decltype(obj.{0})>::deserialize_into(obj.{0}, deserializer);",
+                    field,
+                )?;
+            }
         }
-        writeln!(self.out, "{} obj;", name)?;
+        self.output_decrease_container_depth("deserializer", depth)?;
+        writeln!(self.out, "return obj;")?;
+        self.out.unindent();
+        writeln!(self.out, "}}")
+    }
+
+    fn output_struct_deserializable_into(
+        &mut self,
+        name: &str,
+        fields: &[&str],
+        depth: DepthTracking,
+        has_memcpy_layout: bool,
+    ) -> Result<()> {
+        writeln!(
+            self.out,
+            r#"
+template <>
+template <typename Deserializer>
+void serde::DeserializableInto<{0}>::deserialize_into({0} &obj, Deserializer &deserializer) {{"#,
+            name,
+        )?;
+        self.out.indent();
+        writeln!(
+            self.out,
+            "SERDE_TIME_TYPE(\"{}\", \"deserialize_into\");",
+            name
+        )?;
+        if has_memcpy_layout {
+            self.output_memcpy_fast_path(
+                "deserializer",
+                name,
+                &format!("{}\nreturn;", MEMCPY_DESERIALIZE_INTO_OBJ),
+            )?;
+        }
+        self.output_increase_container_depth("deserializer", depth)?;
         for field in fields {
             writeln!(
                 self.out,
-                "obj.{0} = serde::Deserializable<decltype(obj.{0})>::deserialize(deserializer);",
+                "serde::DeserializableInto<decltype(obj.{0})>::deserialize_into(obj.{0}, deserializer);",
                 field,
             )?;
         }
-        if is_container {
-            writeln!(self.out, "deserializer.decrease_container_depth();")?;
+        self.output_decrease_container_depth("deserializer", depth)?;
+        self.out.unindent();
+        writeln!(self.out, "}}")
+    }
+
+    fn output_struct_skippable(
+        &mut self,
+        name: &str,
+        fields: &[&str],
+        depth: DepthTracking,
+        has_memcpy_layout: bool,
+    ) -> Result<()> {
+        writeln!(
+            self.out,
+            r#"
+template <>
+template <typename Deserializer>
+void serde::Skippable<{0}>::skip(Deserializer &deserializer) {{"#,
+            name,
+        )?;
+        self.out.indent();
+        writeln!(self.out, "SERDE_TIME_TYPE(\"{}\", \"skip\");", name)?;
+        if has_memcpy_layout {
+            self.output_memcpy_fast_path(
+                "deserializer",
+                name,
+                &format!(
+                    "deserializer.deserialize_raw_bytes(sizeof({}));\nreturn;",
+                    name
+                ),
+            )?;
         }
-        writeln!(self.out, "return obj;")?;
+        self.output_increase_container_depth("deserializer", depth)?;
+        for field in fields {
+            writeln!(
+                self.out,
+                "serde::Skippable<decltype({0}::{1})>::skip(deserializer);",
+                name, field,
+            )?;
+        }
+        self.output_decrease_container_depth("deserializer", depth)?;
         self.out.unindent();
         writeln!(self.out, "}}")
     }
@@ -500,25 +989,232 @@ template <typename Deserializer>
         &mut self,
         name: &str,
         fields: &[&str],
-        is_container: bool,
+        depth: DepthTracking,
     ) -> Result<()> {
         self.output_open_namespace()?;
         self.output_struct_equality_test(name, fields)?;
+        if self.generator.config.map_representation == MapRepresentation::Hashed {
+            self.output_struct_hash_value(name, fields)?;
+        }
         if self.generator.config.serialization {
             for encoding in &self.generator.config.encodings {
                 self.output_struct_serialize_for_encoding(&name, *encoding)?;
                 self.output_struct_deserialize_for_encoding(&name, *encoding)?;
+                self.output_struct_deserialize_into_for_encoding(&name, *encoding)?;
+                self.output_struct_validate_for_encoding(&name, *encoding)?;
             }
         }
         self.output_close_namespace()?;
         let namespaced_name = self.quote_qualified_name(name);
         if self.generator.config.serialization {
-            self.output_struct_serializable(&namespaced_name, fields, is_container)?;
-            self.output_struct_deserializable(&namespaced_name, fields, is_container)?;
+            // Custom code may add constructors or virtual methods, after which a generated
+            // class is no longer an aggregate.
+            let mut path = self.current_namespace.clone();
+            path.extend(name.split("::").map(String::from));
+            let is_aggregate = !self.generator.config.custom_code.contains_key(&path);
+            let has_memcpy_layout = self.memcpy_layouts.contains(name);
+            self.output_struct_serializable(&namespaced_name, fields, depth, has_memcpy_layout)?;
+            self.output_struct_deserializable(
+                &namespaced_name,
+                fields,
+                depth,
+                is_aggregate,
+                has_memcpy_layout,
+            )?;
+            self.output_struct_deserializable_into(
+                &namespaced_name,
+                fields,
+                depth,
+                has_memcpy_layout,
+            )?;
+            self.output_struct_skippable(&namespaced_name, fields, depth, has_memcpy_layout)?;
         }
         Ok(())
     }
 
+    fn output_container_encoded_size(
+        &mut self,
+        name: &str,
+        format: &ContainerFormat,
+    ) -> Result<()> {
+        use ContainerFormat::*;
+        let fields = match format {
+            UnitStruct => Vec::new(),
+            NewTypeStruct(_format) => vec!["value"],
+            TupleStruct(_formats) => vec!["value"],
+            Struct(fields) => fields
+                .iter()
+                .map(|field| field.name.as_str())
+                .collect::<Vec<_>>(),
+            // Variant indices do not have a static size in every encoding.
+            Enum(_variants) => return Ok(()),
+        };
+        let namespaced_name = self.quote_qualified_name(name);
+        writeln!(
+            self.out,
+            "template <>\nstruct serde::EncodedSize<{}> : serde::EncodedSizeOf<{}> {{}};\n",
+            namespaced_name,
+            fields
+                .iter()
+                .map(|field| format!("decltype({}::{})", namespaced_name, field))
+                .collect::<Vec<_>>()
+                .join(", "),
+        )
+    }
+
+    fn output_container_memcpy_layout(
+        &mut self,
+        name: &str,
+        format: &ContainerFormat,
+    ) -> Result<()> {
+        if !self.memcpy_layouts.contains(name) {
+            return Ok(());
+        }
+        let fields = match format {
+            ContainerFormat::NewTypeStruct(_format) => vec!["value"],
+            ContainerFormat::Struct(fields) => fields
+                .iter()
+                .map(|field| field.name.as_str())
+                .collect::<Vec<_>>(),
+            _ => return Ok(()),
+        };
+        let namespaced_name = self.quote_qualified_name(name);
+        writeln!(
+            self.out,
+            "template <>\nstruct serde::MemcpyLayout<{0}> : serde::MemcpyLayoutOf<{0}, {1}> {{}};\n",
+            namespaced_name,
+            fields
+                .iter()
+                .map(|field| format!("decltype({}::{})", namespaced_name, field))
+                .collect::<Vec<_>>()
+                .join(", "),
+        )
+    }
+
+    fn output_view_forward_definition(&mut self, name: &str) -> Result<()> {
+        writeln!(
+            self.out,
+            "template <typename Deserializer>\nclass {}View;",
+            name
+        )
+    }
+
+    fn output_container_view(&mut self, name: &str, format: &ContainerFormat) -> Result<()> {
+        use ContainerFormat::*;
+        let fields = match format {
+            UnitStruct => Vec::new(),
+            NewTypeStruct(format) => vec![("value", Some(format.as_ref()))],
+            TupleStruct(_formats) => vec![("value", None)],
+            Struct(fields) => fields
+                .iter()
+                .map(|field| (field.name.as_str(), Some(&field.value)))
+                .collect(),
+            Enum(_variants) => Vec::new(),
+        };
+        writeln!(
+            self.out,
+            r#"
+/// Read-only view over the encoding of a `{0}`. Values are only decoded on access.
+/// The bytes must outlive the view.
+template <typename Deserializer>
+class {0}View {{
+  public:
+    {0}View(const uint8_t *bytes, size_t size) : bytes_(bytes), size_(size) {{}}"#,
+            name
+        )?;
+        self.out.indent();
+        if let Enum(_) = format {
+            writeln!(
+                self.out,
+                r#"
+uint32_t index() const {{
+    return Deserializer(bytes_, size_).deserialize_variant_index();
+}}"#
+            )?;
+        }
+        for (i, (field, format)) in fields.iter().enumerate() {
+            let accessor = Self::view_accessor_name(name, field);
+            writeln!(
+                self.out,
+                r#"
+decltype({0}::{1}) {3}() const {{
+    auto deserializer = seek_field_({2});
+    return serde::Deserializable<decltype({0}::{1})>::deserialize(deserializer);
+}}"#,
+                name, field, i, accessor
+            )?;
+            if let Some(Format::TypeName(type_name)) = format {
+                if !self
+                    .generator
+                    .external_qualified_names
+                    .contains_key(type_name)
+                {
+                    writeln!(
+                        self.out,
+                        r#"
+{0}View<Deserializer> {1}_view() const {{
+    auto offset = seek_field_({2}).get_buffer_offset();
+    return {{bytes_ + offset, size_ - offset}};
+}}"#,
+                        type_name, accessor, i
+                    )?;
+                }
+            }
+        }
+        writeln!(
+            self.out,
+            r#"
+{0} decode() const {{
+    auto deserializer = Deserializer(bytes_, size_);
+    return serde::Deserializable<{0}>::deserialize(deserializer);
+}}"#,
+            name
+        )?;
+        self.out.unindent();
+        writeln!(
+            self.out,
+            "
+  private:"
+        )?;
+        self.out.indent();
+        if !fields.is_empty() {
+            writeln!(
+                self.out,
+                "// Deserializer positioned at the start of the given field.\nDeserializer seek_field_(size_t field) const {{"
+            )?;
+            self.out.indent();
+            writeln!(self.out, "auto deserializer = Deserializer(bytes_, size_);")?;
+            for (i, (field, _)) in fields.iter().enumerate().take(fields.len() - 1) {
+                writeln!(
+                    self.out,
+                    "if (field > {}) {{\n    serde::Skippable<decltype({}::{})>::skip(deserializer);\n}}",
+                    i, name, field
+                )?;
+            }
+            writeln!(self.out, "return deserializer;")?;
+            self.out.unindent();
+            writeln!(self.out, "}}\n")?;
+        }
+        writeln!(self.out, "const uint8_t *bytes_;\nsize_t size_;")?;
+        self.out.unindent();
+        writeln!(self.out, "}};")
+    }
+
+    /// Name of the accessor of a field in the view of `name`. Names that could clash with the
+    /// other members of the view, i.e. its constructor, `decode()`, the `_view()` accessors and
+    /// the private members, which end with an underscore, take a trailing underscore.
+    fn view_accessor_name(name: &str, field: &str) -> String {
+        if field == "decode"
+            || field == format!("{}View", name)
+            || field.ends_with('_')
+            || field.ends_with("_view")
+        {
+            format!("{}_", field)
+        } else {
+            field.to_string()
+        }
+    }
+
     fn get_variant_fields(format: &VariantFormat) -> Vec<&str> {
         use VariantFormat::*;
         match format {
@@ -535,25 +1231,29 @@ template <typename Deserializer>
 
     fn output_container_traits(&mut self, name: &str, format: &ContainerFormat) -> Result<()> {
         use ContainerFormat::*;
+        let depth = match self.max_depths.get(name) {
+            Some(Some(depth)) => DepthTracking::Bounded(*depth),
+            _ => DepthTracking::Unbounded,
+        };
         match format {
-            UnitStruct => self.output_struct_traits(name, &[], true),
-            NewTypeStruct(_format) => self.output_struct_traits(name, &["value"], true),
-            TupleStruct(_formats) => self.output_struct_traits(name, &["value"], true),
+            UnitStruct => self.output_struct_traits(name, &[], depth),
+            NewTypeStruct(_format) => self.output_struct_traits(name, &["value"], depth),
+            TupleStruct(_formats) => self.output_struct_traits(name, &["value"], depth),
             Struct(fields) => self.output_struct_traits(
                 name,
                 &fields
                     .iter()
                     .map(|field| field.name.as_str())
                     .collect::<Vec<_>>(),
-                true,
+                depth,
             ),
             Enum(variants) => {
-                self.output_struct_traits(name, &["value"], true)?;
+                self.output_struct_traits(name, &["value"], depth)?;
                 for variant in variants.values() {
                     self.output_struct_traits(
                         &format!("{}::{}", name, variant.name),
                         &Self::get_variant_fields(&variant.value),
-                        false,
+                        DepthTracking::Untracked,
                     )?;
                 }
                 Ok(())
@@ -597,6 +1297,10 @@ impl crate::SourceInstaller for Installer {
         write!(file, "{}", include_str!("../runtime/cpp/serde.hpp"))?;
         let mut file = self.create_header_file("binary")?;
         write!(file, "{}", include_str!("../runtime/cpp/binary.hpp"))?;
+        let mut file = self.create_header_file("mmap")?;
+        write!(file, "{}", include_str!("../runtime/cpp/mmap.hpp"))?;
+        let mut file = self.create_header_file("dynamic")?;
+        write!(file, "{}", include_str!("../runtime/cpp/dynamic.hpp"))?;
         Ok(())
     }
 
@@ -761,7 +761,7 @@ return new Serde.ValueArray<{0}>(obj);
             writeln!(self.out, "}}")?;
 
             if variant_index.is_none() {
-                for encoding in &self.generator.config.encodings {
+                for encoding in self.generator.config.default_encodings() {
                     self.output_class_serialize_for_encoding(*encoding)?;
                 }
             }
@@ -800,7 +800,7 @@ return new Serde.ValueArray<{0}>(obj);
             writeln!(self.out, "}}")?;
 
             if variant_index.is_none() {
-                for encoding in &self.generator.config.encodings {
+                for encoding in self.generator.config.default_encodings() {
                     self.output_class_deserialize_for_encoding(name, *encoding)?;
                 }
             }
@@ -933,7 +933,7 @@ switch (index) {{"#,
             self.out.unindent();
             writeln!(self.out, "}}")?;
 
-            for encoding in &self.generator.config.encodings {
+            for encoding in self.generator.config.default_encodings() {
                 self.output_class_serialize_for_encoding(*encoding)?;
                 self.output_class_deserialize_for_encoding(name, *encoding)?;
             }
@@ -1040,7 +1040,7 @@ public static {0} Deserialize(Serde.IDeserializer deserializer) {{
                 name
             )?;
 
-            for encoding in &self.generator.config.encodings {
+            for encoding in self.generator.config.default_encodings() {
                 writeln!(
                     self.out,
                     r#"
@@ -1184,7 +1184,7 @@ impl crate::SourceInstaller for Installer {
             .take(dir_path.strip_prefix(&self.install_dir)?.iter().count())
             .collect();
         let mut deps = vec!["Serde".to_string()];
-        for encoding in &config.encodings {
+        for encoding in config.default_encodings() {
             deps.push(encoding.name().to_camel_case());
         }
         let deps: String = deps
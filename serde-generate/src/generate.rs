@@ -74,9 +74,19 @@ struct Options {
     /// if the target language and the generator code support them.
     #[structopt(long)]
     use_c_style_enums: bool,
+
+    /// Allocate the memory of generated values through polymorphic allocators (e.g. `std::pmr`
+    /// in C++), if the target language supports them.
+    #[structopt(long)]
+    use_polymorphic_allocators: bool,
 }
 
-fn get_codegen_config<'a, I>(name: String, runtimes: I, c_style_enums: bool) -> CodeGeneratorConfig
+fn get_codegen_config<'a, I>(
+    name: String,
+    runtimes: I,
+    c_style_enums: bool,
+    polymorphic_allocators: bool,
+) -> CodeGeneratorConfig
 where
     I: IntoIterator<Item = &'a Runtime>,
 {
@@ -95,6 +105,7 @@ where
     CodeGeneratorConfig::new(name)
         .with_encodings(encodings)
         .with_c_style_enums(c_style_enums)
+        .with_polymorphic_allocators(polymorphic_allocators)
 }
 
 fn main() {
@@ -120,7 +131,12 @@ fn main() {
     match options.target_source_dir {
         None => {
             if let Some((registry, name)) = named_registry_opt {
-                let config = get_codegen_config(name, &runtimes, options.use_c_style_enums);
+                let config = get_codegen_config(
+                    name,
+                    &runtimes,
+                    options.use_c_style_enums,
+                    options.use_polymorphic_allocators,
+                );
 
                 let stdout = std::io::stdout();
                 let mut out = stdout.lock();
@@ -168,7 +184,12 @@ fn main() {
                 };
 
             if let Some((registry, name)) = named_registry_opt {
-                let config = get_codegen_config(name, &runtimes, options.use_c_style_enums);
+                let config = get_codegen_config(
+                    name,
+                    &runtimes,
+                    options.use_c_style_enums,
+                    options.use_polymorphic_allocators,
+                );
                 installer.install_module(&config, &registry).unwrap();
             }
 
@@ -119,7 +119,8 @@ where
         writeln!(self.out, "import (")?;
         self.out.indent();
         if self.generator.config.serialization
-            && (Self::has_enum(registry) || !self.generator.config.encodings.is_empty())
+            && (Self::has_enum(registry)
+                || self.generator.config.default_encodings().next().is_some())
         {
             writeln!(self.out, "\"fmt\"")?;
         }
@@ -127,7 +128,7 @@ where
             writeln!(self.out, "\"{}/serde\"", self.generator.serde_module_path)?;
         }
         if self.generator.config.serialization {
-            for encoding in &self.generator.config.encodings {
+            for encoding in self.generator.config.default_encodings() {
                 writeln!(
                     self.out,
                     "\"{}/{}\"",
@@ -650,7 +651,7 @@ return obj, nil
             self.out.unindent();
             writeln!(self.out, "}}")?;
 
-            for encoding in &self.generator.config.encodings {
+            for encoding in self.generator.config.default_encodings() {
                 self.output_struct_serialize_for_encoding(&full_name, *encoding)?;
             }
         }
@@ -685,7 +686,7 @@ return obj, nil
             writeln!(self.out, "}}")?;
 
             if variant_base.is_none() {
-                for encoding in &self.generator.config.encodings {
+                for encoding in self.generator.config.default_encodings() {
                     self.output_struct_deserialize_for_encoding(&full_name, *encoding)?;
                 }
             }
@@ -746,7 +747,7 @@ return obj, nil
             self.out.unindent();
             writeln!(self.out, "}}")?;
 
-            for encoding in &self.generator.config.encodings {
+            for encoding in self.generator.config.default_encodings() {
                 self.output_struct_serialize_for_encoding(&full_name, *encoding)?;
             }
         }
@@ -776,7 +777,7 @@ return obj, nil
             writeln!(self.out, "}}")?;
 
             if variant_base.is_none() {
-                for encoding in &self.generator.config.encodings {
+                for encoding in self.generator.config.default_encodings() {
                     self.output_struct_deserialize_for_encoding(&full_name, *encoding)?;
                 }
             }
@@ -847,7 +848,7 @@ func {2}Deserialize{0}(input []byte) ({0}, error) {{
         writeln!(self.out, "is{}()", name)?;
         if self.generator.config.serialization {
             writeln!(self.out, "Serialize(serializer serde.Serializer) error")?;
-            for encoding in &self.generator.config.encodings {
+            for encoding in self.generator.config.default_encodings() {
                 writeln!(
                     self.out,
                     "{}Serialize() ([]byte, error)",
@@ -896,7 +897,7 @@ switch index {{"#,
             self.out.unindent();
             writeln!(self.out, "}}")?;
 
-            for encoding in &self.generator.config.encodings {
+            for encoding in self.generator.config.default_encodings() {
                 self.output_struct_deserialize_for_encoding(name, *encoding)?;
             }
         }
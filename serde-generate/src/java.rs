@@ -679,7 +679,7 @@ return obj;
             writeln!(self.out, "}}")?;
 
             if variant_index.is_none() {
-                for encoding in &self.generator.config.encodings {
+                for encoding in self.generator.config.default_encodings() {
                     self.output_class_serialize_for_encoding(*encoding)?;
                 }
             }
@@ -716,7 +716,7 @@ return obj;
             writeln!(self.out, "}}")?;
 
             if variant_index.is_none() {
-                for encoding in &self.generator.config.encodings {
+                for encoding in self.generator.config.default_encodings() {
                     self.output_class_deserialize_for_encoding(name, *encoding)?;
                 }
             }
@@ -857,7 +857,7 @@ switch (index) {{"#,
             self.out.unindent();
             writeln!(self.out, "}}")?;
 
-            for encoding in &self.generator.config.encodings {
+            for encoding in self.generator.config.default_encodings() {
                 self.output_class_serialize_for_encoding(*encoding)?;
                 self.output_class_deserialize_for_encoding(name, *encoding)?;
             }
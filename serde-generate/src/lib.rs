@@ -28,7 +28,8 @@
 //!
 //! This crate provides easy-to-deploy runtime libraries for the following binary formats, in all supported languages:
 //!
-//! * [Bincode](https://docs.rs/bincode/1.3.1/bincode/) (default configuration only),
+//! * [Bincode](https://docs.rs/bincode/1.3.1/bincode/) (default configuration only, except in C++ where
+//!   variable-length and big-endian integers are also supported),
 //! * [BCS](https://github.com/diem/bcs) (short for Binary Canonical Serialization, the main format used
 //!   in the [Diem blockchain](https://github.com/diem/diem)).
 //!
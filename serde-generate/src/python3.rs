@@ -113,7 +113,7 @@ import typing
 {}import serde_types as st"#,
             from_serde_package,
         )?;
-        for encoding in &self.generator.config.encodings {
+        for encoding in self.generator.config.default_encodings() {
             writeln!(self.out, "{}import {}", from_serde_package, encoding.name())?;
         }
         for module in self.generator.config.external_definitions.keys() {
@@ -278,7 +278,7 @@ import typing
                 "VARIANTS = []  # type: typing.Sequence[typing.Type[{}]]",
                 name
             )?;
-            for encoding in &self.generator.config.encodings {
+            for encoding in self.generator.config.default_encodings() {
                 self.output_serialize_method_for_encoding(name, *encoding)?;
                 self.output_deserialize_method_for_encoding(name, *encoding)?;
             }
@@ -369,7 +369,7 @@ def {0}_deserialize(input: bytes) -> '{1}':
         self.output_comment(name)?;
         self.current_namespace.push(name.to_string());
         self.output_fields(&fields)?;
-        for encoding in &self.generator.config.encodings {
+        for encoding in self.generator.config.default_encodings() {
             self.output_serialize_method_for_encoding(name, *encoding)?;
             self.output_deserialize_method_for_encoding(name, *encoding)?;
         }
@@ -57,6 +57,29 @@ fn test_topological_sort() {
     );
 }
 
+#[test]
+fn test_max_depths() {
+    assert_eq!(
+        analyzer::get_max_depths(&btreemap! {
+            1 => btreeset![2, 3],
+            2 => btreeset![3],
+            3 => btreeset![],
+        }),
+        btreemap! { 1 => Some(3), 2 => Some(2), 3 => Some(1) }
+    );
+    // Cycles and missing names are unbounded, as well as entries depending on them.
+    assert_eq!(
+        analyzer::get_max_depths(&btreemap! {
+            1 => btreeset![2],
+            2 => btreeset![1],
+            3 => btreeset![1],
+            4 => btreeset![4],
+            5 => btreeset![6],
+        }),
+        btreemap! { 1 => None, 2 => None, 3 => None, 4 => None, 5 => None }
+    );
+}
+
 #[test]
 fn test_on_larger_registry() {
     let registry = test_utils::get_registry().unwrap();
@@ -77,6 +100,12 @@ fn test_on_larger_registry() {
         )
     );
 
+    // References nested in vectors do not contribute to the size of values.
+    let sizes = analyzer::get_size_dependency_map(&registry);
+    assert_eq!(sizes.get("Tree").unwrap(), &btreeset!("SerdeData"));
+    assert_eq!(sizes.get("OtherTypes").unwrap(), &btreeset!("Struct"));
+    assert_eq!(sizes.get("SimpleList").unwrap(), &btreeset!("SimpleList"));
+
     let vector = analyzer::best_effort_topological_sort(&map);
     assert_eq!(
         vector,
@@ -0,0 +1,364 @@
+// Copyright (c) Facebook, Inc. and its affiliates
+// SPDX-License-Identifier: MIT OR Apache-2.0
+
+//! Throughput benchmarks of the C++ runtime and of the generated code.
+//!
+//! These are ignored by default. Run them with
+//! `cargo test --release --test cpp_benchmarks -- --ignored --nocapture --test-threads 1`.
+
+use serde::{Deserialize, Serialize};
+use serde_bytes::ByteBuf;
+use serde_generate::{cpp, test_utils, test_utils::Runtime, CodeGeneratorConfig};
+use serde_reflection::{Registry, Samples, Tracer, TracerConfig};
+use std::collections::BTreeMap;
+use std::fs::File;
+use std::io::Write;
+use std::path::Path;
+use std::process::Command;
+use tempfile::tempdir;
+
+// A large schema made of deeply nested enums, similar to the bytecode of a program.
+#[derive(Serialize, Deserialize)]
+struct Program {
+    name: String,
+    functions: Vec<Function>,
+}
+
+#[derive(Serialize, Deserialize)]
+struct Function {
+    name: String,
+    parameters: Vec<Type>,
+    blocks: Vec<Block>,
+}
+
+#[derive(Serialize, Deserialize)]
+struct Block {
+    label: u32,
+    instructions: Vec<Instruction>,
+}
+
+#[derive(Serialize, Deserialize)]
+enum Instruction {
+    Nop,
+    Push(Value),
+    Load {
+        slot: u16,
+        offset: u32,
+    },
+    Store {
+        slot: u16,
+        offset: u32,
+    },
+    Call {
+        function: u32,
+        arguments: Vec<Value>,
+    },
+    Jump(u32),
+    Return(Option<Value>),
+}
+
+#[derive(Serialize, Deserialize)]
+enum Value {
+    Unit,
+    Bool(bool),
+    U64(u64),
+    I32(i32),
+    Str(String),
+    Typed(Type, u64),
+}
+
+#[derive(Serialize, Deserialize)]
+enum Type {
+    Bool,
+    U8,
+    U64,
+    Address,
+    Signer,
+    Vector(u8),
+}
+
+// A schema dominated by byte blobs and by a map that BCS must canonicalize.
+#[derive(Serialize, Deserialize)]
+struct Snapshot {
+    version: u64,
+    blobs: Vec<ByteBuf>,
+    index: BTreeMap<String, u64>,
+}
+
+fn get_program_registry() -> Registry {
+    let mut tracer = Tracer::new(TracerConfig::default());
+    let samples = Samples::new();
+    tracer.trace_type::<Program>(&samples).unwrap();
+    tracer.trace_type::<Instruction>(&samples).unwrap();
+    tracer.trace_type::<Value>(&samples).unwrap();
+    tracer.trace_type::<Type>(&samples).unwrap();
+    tracer.registry().unwrap()
+}
+
+fn get_snapshot_registry() -> Registry {
+    let mut tracer = Tracer::new(TracerConfig::default());
+    let samples = Samples::new();
+    tracer.trace_type::<Snapshot>(&samples).unwrap();
+    tracer.registry().unwrap()
+}
+
+fn get_program() -> Program {
+    let value = |i: u32| match i % 6 {
+        0 => Value::Unit,
+        1 => Value::Bool(i % 4 == 1),
+        2 => Value::U64(u64::from(i) << 20),
+        3 => Value::I32(-(i as i32)),
+        4 => Value::Str(format!("constant_{}", i)),
+        _ => Value::Typed(Type::Vector(8), u64::from(i)),
+    };
+    let instruction = |i: u32| match i % 7 {
+        0 => Instruction::Nop,
+        1 => Instruction::Push(value(i)),
+        2 => Instruction::Load {
+            slot: i as u16,
+            offset: i * 8,
+        },
+        3 => Instruction::Store {
+            slot: i as u16,
+            offset: i * 8,
+        },
+        4 => Instruction::Call {
+            function: i % 32,
+            arguments: (i..i + 3).map(value).collect(),
+        },
+        5 => Instruction::Jump(i % 8),
+        _ => Instruction::Return(Some(value(i))),
+    };
+    Program {
+        name: "benchmark".to_string(),
+        functions: (0..32)
+            .map(|f| Function {
+                name: format!("function_{}", f),
+                parameters: vec![Type::Bool, Type::U8, Type::U64, Type::Address, Type::Signer],
+                blocks: (0..8)
+                    .map(|b| Block {
+                        label: b,
+                        instructions: (0..32).map(|i| instruction(f * 256 + b * 32 + i)).collect(),
+                    })
+                    .collect(),
+            })
+            .collect(),
+    }
+}
+
+fn get_snapshot() -> Snapshot {
+    Snapshot {
+        version: 1,
+        blobs: (0..64u8).map(|i| ByteBuf::from(vec![i; 4096])).collect(),
+        index: (0..1024u64)
+            .map(|i| (format!("key_{}", i * 7919 % 1024), i))
+            .collect(),
+    }
+}
+
+// Write the given encodings in the record format of `mmap.hpp`.
+fn write_records(path: &Path, records: &[Vec<u8>]) {
+    let mut file = File::create(path).unwrap();
+    for record in records {
+        file.write_all(&(record.len() as u64).to_le_bytes())
+            .unwrap();
+        file.write_all(record).unwrap();
+    }
+}
+
+fn output_header(path: &Path, namespace: &str, registry: &Registry, runtime: Runtime) {
+    let mut header = File::create(path).unwrap();
+    let config =
+        CodeGeneratorConfig::new(namespace.to_string()).with_encodings(vec![runtime.into()]);
+    let generator = cpp::CodeGenerator::new(&config);
+    generator.output(&mut header, registry).unwrap();
+}
+
+#[test]
+#[ignore]
+fn bench_cpp_bcs_runtime() {
+    bench_cpp_runtime(Runtime::Bcs);
+}
+
+#[test]
+#[ignore]
+fn bench_cpp_bincode_runtime() {
+    bench_cpp_runtime(Runtime::Bincode);
+}
+
+fn bench_cpp_runtime(runtime: Runtime) {
+    let dir = tempdir().unwrap();
+    output_header(
+        &dir.path().join("supported.hpp"),
+        "supported",
+        &test_utils::get_registry().unwrap(),
+        runtime,
+    );
+    output_header(
+        &dir.path().join("program.hpp"),
+        "program",
+        &get_program_registry(),
+        runtime,
+    );
+    output_header(
+        &dir.path().join("snapshot.hpp"),
+        "snapshot",
+        &get_snapshot_registry(),
+        runtime,
+    );
+    write_records(
+        &dir.path().join("supported.bin"),
+        &runtime.get_positive_samples_quick(),
+    );
+    write_records(
+        &dir.path().join("program.bin"),
+        &[runtime.serialize(&get_program())],
+    );
+    write_records(
+        &dir.path().join("snapshot.bin"),
+        &[runtime.serialize(&get_snapshot())],
+    );
+    let canonicalization = if runtime.has_canonical_maps() {
+        r#"
+    // Sorting the entries of a map by their encoded keys.
+    auto &index = snapshots[0].index;
+    auto size = serde::BcsSerializer::serialized_size(index);
+    bench("snapshot/canonicalize_map", size, [&] {
+        auto serializer = serde::BcsSerializer();
+        serde::Serializable<std::decay_t<decltype(index)>>::serialize(index, serializer);
+        keep(serializer);
+    });"#
+    } else {
+        ""
+    };
+
+    let source_path = dir.path().join("bench.cpp");
+    let mut source = File::create(&source_path).unwrap();
+    writeln!(
+        source,
+        r#"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include "mmap.hpp"
+#include "supported.hpp"
+#include "program.hpp"
+#include "snapshot.hpp"
+
+// Allocations are counted by replacing the global allocation functions.
+static size_t allocations = 0;
+
+void *operator new(size_t size) {{
+    allocations++;
+    if (void *ptr = std::malloc(size ? size : 1)) {{
+        return ptr;
+    }}
+    throw std::bad_alloc();
+}}
+
+void operator delete(void *ptr) noexcept {{ std::free(ptr); }}
+void operator delete(void *ptr, size_t) noexcept {{ std::free(ptr); }}
+
+// Prevent the compiler from discarding the results of benchmarked code.
+template <typename T>
+void keep(const T &value) {{
+    asm volatile("" : : "g"(&value) : "memory");
+}}
+
+// Run `op` for about 200ms and report its cost per call. `bytes` is the
+// number of encoded bytes processed by each call.
+template <typename F>
+void bench(const std::string &name, size_t bytes, F op) {{
+    using clock = std::chrono::steady_clock;
+    op();
+    size_t iterations = 0;
+    size_t start_allocations = allocations;
+    auto start = clock::now();
+    std::chrono::duration<double, std::nano> elapsed;
+    do {{
+        op();
+        iterations++;
+        elapsed = clock::now() - start;
+    }} while (elapsed < std::chrono::milliseconds(200));
+    double ns = elapsed.count() / iterations;
+    std::printf("{0:<8} %-28s %12.0f ns/op %10.1f MB/s %10.1f allocs/op\n",
+                name.c_str(), ns, bytes * 1e3 / ns,
+                double(allocations - start_allocations) / iterations);
+}}
+
+std::vector<std::vector<uint8_t>> read_records(const char *path) {{
+    serde::MappedFile file(path);
+    serde::RecordReader reader(file.data(), file.size());
+    std::vector<std::vector<uint8_t>> records;
+    while (auto record = reader.next()) {{
+        records.emplace_back(record->data, record->data + record->size);
+    }}
+    return records;
+}}
+
+// Benchmark the generated entry points of `T` over the given inputs.
+template <typename T>
+std::vector<T> bench_type(const std::string &name, const char *path) {{
+    auto inputs = read_records(path);
+    size_t bytes = 0;
+    std::vector<T> values;
+    for (auto &input : inputs) {{
+        bytes += input.size();
+        values.push_back(T::{0}Deserialize(input));
+    }}
+    bench(name + "/deserialize", bytes, [&] {{
+        for (auto &input : inputs) {{
+            keep(T::{0}Deserialize(input.data(), input.size()));
+        }}
+    }});
+    std::vector<uint8_t> output;
+    bench(name + "/serialize", bytes, [&] {{
+        for (auto &value : values) {{
+            value.{0}Serialize(output);
+            keep(output);
+        }}
+    }});
+    bench(name + "/validate", bytes, [&] {{
+        for (auto &input : inputs) {{
+            keep(T::{0}Validate(input.data(), input.size()));
+        }}
+    }});
+    return values;
+}}
+
+int main() {{
+    bench_type<supported::SerdeData>("supported", "{1}");
+    bench_type<program::Program>("program", "{2}");
+    auto snapshots = bench_type<snapshot::Snapshot>("snapshot", "{3}");
+    {4}
+    return 0;
+}}
+"#,
+        runtime.name(),
+        dir.path().join("supported.bin").to_str().unwrap(),
+        dir.path().join("program.bin").to_str().unwrap(),
+        dir.path().join("snapshot.bin").to_str().unwrap(),
+        canonicalization,
+    )
+    .unwrap();
+
+    let status = Command::new("clang++")
+        .arg("--std=c++17")
+        .arg("-O2")
+        .arg("-DNDEBUG")
+        .arg("-o")
+        .arg(dir.path().join("bench"))
+        .arg("-I")
+        .arg("runtime/cpp")
+        .arg("-I")
+        .arg(dir.path())
+        .arg(source_path)
+        .status()
+        .unwrap();
+    assert!(status.success());
+
+    let status = Command::new(dir.path().join("bench")).status().unwrap();
+    assert!(status.success());
+}
@@ -1,7 +1,9 @@
 // Copyright (c) Facebook, Inc. and its affiliates
 // SPDX-License-Identifier: MIT OR Apache-2.0
 
-use serde_generate::{cpp, test_utils, CodeGeneratorConfig, Encoding};
+use serde::Deserialize;
+use serde_generate::{cpp, test_utils, CodeGeneratorConfig, Encoding, MapRepresentation};
+use serde_reflection::{Tracer, TracerConfig};
 use std::collections::BTreeMap;
 use std::fs::File;
 use std::io::Write;
@@ -71,6 +73,44 @@ fn test_that_cpp_code_compiles_without_serialization() {
     test_that_cpp_code_compiles_with_config(&config);
 }
 
+#[test]
+fn test_that_cpp_code_compiles_with_polymorphic_allocators() {
+    let config = CodeGeneratorConfig::new("testing".to_string())
+        .with_encodings(vec![Encoding::Bcs, Encoding::Bincode])
+        .with_polymorphic_allocators(true);
+    let (_dir, header_path) = test_that_cpp_code_compiles_with_config(&config);
+
+    let content = std::fs::read_to_string(&header_path).unwrap();
+    assert!(content.contains("std::pmr::vector<"));
+    assert!(content.contains("serde::pmr::value_ptr<"));
+}
+
+#[test]
+fn test_that_cpp_code_compiles_with_map_representations() {
+    for (map_representation, expected) in vec![
+        (
+            MapRepresentation::Flat,
+            "serde::flat_map<std::string, uint32_t>",
+        ),
+        (
+            MapRepresentation::Hashed,
+            "std::unordered_map<std::string, uint32_t, serde::hash<std::string>>",
+        ),
+        (
+            MapRepresentation::Custom("std::map".to_string()),
+            "std::map<std::string, uint32_t>",
+        ),
+    ] {
+        let config = CodeGeneratorConfig::new("testing".to_string())
+            .with_encodings(vec![Encoding::Bcs, Encoding::Bincode])
+            .with_map_representation(map_representation);
+        let (_dir, header_path) = test_that_cpp_code_compiles_with_config(&config);
+
+        let content = std::fs::read_to_string(&header_path).unwrap();
+        assert!(content.contains(expected));
+    }
+}
+
 #[test]
 fn test_that_cpp_code_compiles_with_comments() {
     let comments = vec![
@@ -232,3 +272,153 @@ int main() {{
         .unwrap();
     assert!(status.success());
 }
+
+// A cycle of definitions through a vector.
+#[derive(Deserialize)]
+#[allow(dead_code)]
+struct Module {
+    name: String,
+    items: Vec<Item>,
+}
+
+#[derive(Deserialize)]
+#[allow(dead_code)]
+enum Item {
+    Function(String),
+    Module(Module),
+}
+
+#[test]
+fn test_that_cpp_code_only_boxes_recursive_layouts() {
+    let mut tracer = Tracer::new(TracerConfig::default());
+    tracer.trace_simple_type::<Item>().unwrap();
+    let registry = tracer.registry().unwrap();
+    let dir = tempdir().unwrap();
+    let header_path = dir.path().join("test.hpp");
+    let mut header = File::create(&header_path).unwrap();
+
+    let config =
+        CodeGeneratorConfig::new("testing".to_string()).with_encodings(vec![Encoding::Bcs]);
+    let generator = cpp::CodeGenerator::new(&config);
+    generator.output(&mut header, &registry).unwrap();
+
+    // Vectors accept incomplete element types: `Module` is defined first and stored inline.
+    let content = std::fs::read_to_string(&header_path).unwrap();
+    assert!(content.contains("std::vector<testing::Item> items;"));
+    assert!(content.contains("testing::Module value;"));
+    assert!(!content.contains("value_ptr"));
+
+    let source_path = dir.path().join("test.cpp");
+    let mut source = File::create(&source_path).unwrap();
+    writeln!(
+        source,
+        r#"
+#include <cassert>
+#include "test.hpp"
+
+using namespace testing;
+
+int main() {{
+    Module module = {{"m", {{Item{{Item::Function{{"f"}}}}}}}};
+    Item item = {{Item::Module{{module}}}};
+    auto bytes = item.bcsSerialize();
+    assert(Item::bcsDeserialize(bytes) == item);
+    return 0;
+}}
+"#
+    )
+    .unwrap();
+
+    let status = Command::new("clang++")
+        .arg("--std=c++17")
+        .arg("-I")
+        .arg("runtime/cpp")
+        .arg("-o")
+        .arg(dir.path().join("test"))
+        .arg(&source_path)
+        .status()
+        .unwrap();
+    assert!(status.success());
+
+    let status = Command::new(dir.path().join("test")).status().unwrap();
+    assert!(status.success());
+}
+
+// Fields named like the members of generated views.
+#[derive(Deserialize)]
+#[allow(dead_code)]
+struct Record {
+    decode: u8,
+    index: u16,
+    seek: u32,
+    bytes_: String,
+    size_: u64,
+    seek_field_: bool,
+    child: Child,
+    child_view: u8,
+}
+
+#[derive(Deserialize)]
+#[allow(dead_code)]
+struct Child {
+    decode: Vec<u8>,
+}
+
+#[test]
+fn test_that_cpp_views_escape_clashing_field_names() {
+    let mut tracer = Tracer::new(TracerConfig::default());
+    tracer.trace_simple_type::<Record>().unwrap();
+    let registry = tracer.registry().unwrap();
+    let dir = tempdir().unwrap();
+    let header_path = dir.path().join("test.hpp");
+    let mut header = File::create(&header_path).unwrap();
+
+    let config = CodeGeneratorConfig::new("testing".to_string())
+        .with_encodings(vec![Encoding::Bcs])
+        .with_views(true);
+    let generator = cpp::CodeGenerator::new(&config);
+    generator.output(&mut header, &registry).unwrap();
+
+    let source_path = dir.path().join("test.cpp");
+    let mut source = File::create(&source_path).unwrap();
+    writeln!(
+        source,
+        r#"
+#include <cassert>
+#include "test.hpp"
+
+using namespace testing;
+
+int main() {{
+    Record record = {{1, 2, 3, "bytes", 5, true, Child{{{{6, 7}}}}, 8}};
+    auto bytes = record.bcsSerialize();
+    auto view = RecordView<serde::BcsDeserializer>(bytes.data(), bytes.size());
+    assert(view.decode_() == 1);
+    assert(view.index() == 2);
+    assert(view.seek() == 3);
+    assert(view.bytes__() == "bytes");
+    assert(view.size__() == 5);
+    assert(view.seek_field__());
+    assert(view.child_view().decode_() == std::vector<uint8_t>({{6, 7}}));
+    assert(view.child_view_() == 8);
+    assert(view.decode() == record);
+    return 0;
+}}
+"#
+    )
+    .unwrap();
+
+    let status = Command::new("clang++")
+        .arg("--std=c++17")
+        .arg("-I")
+        .arg("runtime/cpp")
+        .arg("-o")
+        .arg(dir.path().join("test"))
+        .arg(&source_path)
+        .status()
+        .unwrap();
+    assert!(status.success());
+
+    let status = Command::new(dir.path().join("test")).status().unwrap();
+    assert!(status.success());
+}
@@ -1,11 +1,14 @@
 // Copyright (c) Facebook, Inc. and its affiliates
 // SPDX-License-Identifier: MIT OR Apache-2.0
 
+use heck::CamelCase;
+use serde::Deserialize;
 use serde_generate::{
     cpp, test_utils,
     test_utils::{Choice, Runtime, Test},
-    CodeGeneratorConfig,
+    CodeGeneratorConfig, Encoding, MapRepresentation,
 };
+use serde_reflection::{Tracer, TracerConfig};
 use std::fs::File;
 use std::io::Write;
 use std::process::Command;
@@ -27,8 +30,9 @@ fn test_cpp_runtime_on_simple_date(runtime: Runtime) {
     let header_path = dir.path().join("test.hpp");
     let mut header = File::create(&header_path).unwrap();
 
-    let config =
-        CodeGeneratorConfig::new("testing".to_string()).with_encodings(vec![runtime.into()]);
+    let config = CodeGeneratorConfig::new("testing".to_string())
+        .with_encodings(vec![runtime.into()])
+        .with_views(true);
     let generator = cpp::CodeGenerator::new(&config);
     generator.output(&mut header, &registry).unwrap();
 
@@ -59,10 +63,45 @@ int main() {{
 
     assert(value == value2);
 
+    // Borrowed input is decoded without copying it.
+    auto value3 = Test::{1}Deserialize(input.data(), input.size());
+    assert(value3 == value2);
+
+    // Views only decode the fields that are accessed.
+    auto view = TestView<serde::{2}Deserializer>(input.data(), input.size());
+    assert(view.b() == b);
+    assert(view.c_view().index() == 2);
+    assert(view.decode() == value2);
+
     auto output = value2.{1}Serialize();
 
     assert(input == output);
 
+    // Caller-provided buffers keep their capacity across messages.
+    std::vector<uint8_t> reused;
+    value2.{1}Serialize(reused);
+    assert(reused == input);
+    auto capacity = reused.capacity();
+    value2.{1}Serialize(reused);
+    assert(reused == input && reused.capacity() == capacity);
+
+    uint8_t buffer[64];
+    auto size = value2.{1}Serialize(buffer, sizeof(buffer));
+    assert(std::vector<uint8_t>(buffer, buffer + size) == input);
+    try {{
+        value2.{1}Serialize(buffer, input.size() - 1);
+        return 1;
+    }} catch (serde::serialization_error const &e) {{
+        // All good
+    }}
+
+    // Serializers can be reset and reused.
+    auto serializer = serde::{2}Serializer();
+    serde::Serializable<Test>::serialize(value, serializer);
+    serializer.reset();
+    serde::Serializable<Test>::serialize(value2, serializer);
+    assert(serializer.bytes() == input);
+
     input.push_back(1);
     try {{
         Test::{1}Deserialize(input);
@@ -78,6 +117,7 @@ int main() {{
             .collect::<Vec<_>>()
             .join(", "),
         runtime.name(),
+        runtime.name().to_camel_case(),
     )
     .unwrap();
 
@@ -98,12 +138,23 @@ int main() {{
 
 #[test]
 fn test_cpp_bcs_runtime_on_supported_types() {
-    test_cpp_runtime_on_supported_types(Runtime::Bcs);
+    test_cpp_runtime_on_supported_types(Runtime::Bcs, MapRepresentation::Ordered);
 }
 
 #[test]
 fn test_cpp_bincode_runtime_on_supported_types() {
-    test_cpp_runtime_on_supported_types(Runtime::Bincode);
+    test_cpp_runtime_on_supported_types(Runtime::Bincode, MapRepresentation::Ordered);
+}
+
+#[test]
+fn test_cpp_bcs_runtime_on_supported_types_with_flat_maps() {
+    test_cpp_runtime_on_supported_types(Runtime::Bcs, MapRepresentation::Flat);
+}
+
+// Hash maps are only encoded canonically with BCS, which sorts their entries.
+#[test]
+fn test_cpp_bcs_runtime_on_supported_types_with_hash_maps() {
+    test_cpp_runtime_on_supported_types(Runtime::Bcs, MapRepresentation::Hashed);
 }
 
 fn quote_bytes(bytes: &[u8]) -> String {
@@ -117,14 +168,16 @@ fn quote_bytes(bytes: &[u8]) -> String {
     )
 }
 
-fn test_cpp_runtime_on_supported_types(runtime: Runtime) {
+fn test_cpp_runtime_on_supported_types(runtime: Runtime, map_representation: MapRepresentation) {
     let registry = test_utils::get_registry().unwrap();
     let dir = tempdir().unwrap();
     let header_path = dir.path().join("test.hpp");
     let mut header = File::create(&header_path).unwrap();
 
-    let config =
-        CodeGeneratorConfig::new("testing".to_string()).with_encodings(vec![runtime.into()]);
+    let config = CodeGeneratorConfig::new("testing".to_string())
+        .with_encodings(vec![runtime.into()])
+        .with_views(true)
+        .with_map_representation(map_representation);
     let generator = cpp::CodeGenerator::new(&config);
     generator.output(&mut header, &registry).unwrap();
 
@@ -148,20 +201,113 @@ fn test_cpp_runtime_on_supported_types(runtime: Runtime) {
 #include <algorithm>
 #include <exception>
 #include <iostream>
+#include <sstream>
 #include <cassert>
 #include "test.hpp"
 
 using namespace testing;
 
+// Containers made of fixed-size fields have a static encoded size.
+static_assert(serde::EncodedSize<Struct>::value == 12);
+static_assert(serde::EncodedSize<TupleStruct>::value == 12);
+static_assert(serde::EncodedSize<UnitStruct>::is_static);
+static_assert(!serde::EncodedSize<OtherTypes>::is_static);
+
+// Structs of fixed-width integers without padding are copied with a memcpy.
+static_assert(serde::MemcpyLayout<NewTypeStruct>::value);
+static_assert(!serde::MemcpyLayout<Struct>::value);
+
 int main() {{
     std::vector<std::vector<uint8_t>> positive_inputs = {{{0}}};
     std::vector<std::vector<uint8_t>> negative_inputs = {{{1}}};
     try {{
+        // Sequences of such structs round-trip through a single copy.
+        {{
+            std::vector<NewTypeStruct> values = {{NewTypeStruct{{1}}, NewTypeStruct{{2}}}};
+            auto serializer = serde::{3}Serializer();
+            serde::Serializable<decltype(values)>::serialize(values, serializer);
+            auto bytes = std::move(serializer).bytes();
+            auto deserializer = serde::{3}Deserializer(bytes);
+            assert(serde::Deserializable<decltype(values)>::deserialize(deserializer) == values);
+            assert(deserializer.get_buffer_offset() == bytes.size());
+        }}
+
+        // Long-lived value decoded into, keeping storage across inputs.
+        SerdeData reused;
         for (auto input: positive_inputs) {{
             auto value = SerdeData::{2}Deserialize(input);
             auto output = value.{2}Serialize();
             assert(input == output);
 
+            // Decoding into an existing value gives the same value.
+            reused.{2}DeserializeInto(input);
+            assert(reused == value);
+            reused.{2}DeserializeInto(input);
+            assert(reused == value);
+
+            // Pulling the input one byte at a time gives the same value.
+            {{
+                size_t pos = 0;
+                auto deserializer = serde::{3}Deserializer(serde::Source(
+                    [&](uint8_t *buffer, size_t len) -> size_t {{
+                        if (pos == input.size()) {{
+                            return 0;
+                        }}
+                        buffer[0] = input[pos++];
+                        return 1;
+                    }}));
+                assert(serde::Deserializable<SerdeData>::deserialize(deserializer) == value);
+                assert(deserializer.get_buffer_offset() == input.size());
+            }}
+
+            // Reading a stream of messages leaves the bytes of the next one to the caller.
+            {{
+                std::string message(input.begin(), input.end());
+                std::istringstream stream(message + message);
+                auto deserializer = serde::{3}Deserializer(serde::istream_source(stream));
+                assert(serde::Deserializable<SerdeData>::deserialize(deserializer) == value);
+                auto buffered = deserializer.take_buffered_bytes();
+                auto rest = std::string(buffered.begin(), buffered.end()) +
+                    std::string(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+                assert(rest == message);
+            }}
+
+            // Decoding the elements of sequences in parallel gives the same value.
+            {{
+                auto deserializer = serde::{3}Deserializer(input);
+                deserializer.set_parallel_executor(serde::thread_executor(4), SIZE_MAX, 1);
+                assert(serde::Deserializable<SerdeData>::deserialize(deserializer) == value);
+            }}
+
+            // The error-code path agrees with the exception path.
+            {{
+                auto result = SerdeData::{2}TryDeserialize(input.data(), input.size());
+                assert(result && *result == value);
+            }}
+
+            // Validation consumes the same bytes without decoding.
+            assert(SerdeData::{2}Validate(input.data(), input.size()) == input.size());
+            assert(serde::{3}Serializer::serialized_size(value) == input.size());
+
+            // Encoding sequences and maps in parallel produces the same bytes.
+            {{
+                auto serializer = serde::{3}Serializer();
+                serializer.set_parallel_executor(serde::thread_executor(4), SIZE_MAX, 1);
+                serde::Serializable<SerdeData>::serialize(value, serializer);
+                assert(std::move(serializer).bytes() == input);
+            }}
+
+            // Streaming through a small buffer produces the same bytes.
+            {{
+                std::ostringstream stream;
+                auto serializer = serde::Basic{3}Serializer<serde::SinkOutput<serde::OstreamSink>>(
+                    serde::SinkOutput<serde::OstreamSink>(serde::OstreamSink(stream), 7));
+                serde::Serializable<SerdeData>::serialize(value, serializer);
+                serializer.output().flush();
+                auto bytes = stream.str();
+                assert(std::vector<uint8_t>(bytes.begin(), bytes.end()) == input);
+            }}
+
             // Test self-equality for the Serde value.
             {{
                 auto value2 = SerdeData::{2}Deserialize(input);
@@ -185,7 +331,86 @@ int main() {{
             }}
         }}
 
+        // Batches share one buffer and decode back to the same values.
+        {{
+            std::vector<SerdeData> values;
+            std::vector<uint8_t> bytes;
+            for (auto input: positive_inputs) {{
+                values.push_back(SerdeData::{2}Deserialize(input));
+                bytes.insert(bytes.end(), input.begin(), input.end());
+            }}
+            auto batch = serde::{3}Serializer::serialize_batch(values);
+            assert(batch.bytes == bytes);
+            assert(batch.offsets.size() == values.size() + 1);
+            assert(serde::{3}Deserializer::deserialize_batch<SerdeData>(batch) == values);
+        }}
+
+        // Variant indices must be in range.
+        {{
+            auto serializer = serde::{3}Serializer();
+            serializer.serialize_variant_index(
+                std::variant_size_v<decltype(SerdeData::value)>);
+            try {{
+                SerdeData::{2}Deserialize(std::move(serializer).bytes());
+                assert(false);
+            }} catch (serde::deserialization_error e) {{
+                // All good
+            }}
+        }}
+
+        // Maps round-trip whether or not their order matches the encoded keys.
+        {{
+            std::map<uint32_t, bool> map = {{{{1, true}}, {{256, false}}, {{2, true}}}};
+            serde::flat_map<uint32_t, bool> flat = {{{{256, false}}, {{1, true}}, {{2, true}}}};
+            std::unordered_map<uint32_t, bool, serde::hash<uint32_t>> hashed(map.begin(), map.end());
+            auto serializer = serde::{3}Serializer();
+            serde::Serializable<decltype(map)>::serialize(map, serializer);
+            auto bytes = std::move(serializer).bytes();
+            auto deserializer = serde::{3}Deserializer(bytes);
+            assert(serde::Deserializable<decltype(map)>::deserialize(deserializer) == map);
+            deserializer = serde::{3}Deserializer(bytes);
+            assert(serde::Deserializable<decltype(flat)>::deserialize(deserializer) == flat);
+            deserializer = serde::{3}Deserializer(bytes);
+            assert(serde::Deserializable<decltype(hashed)>::deserialize(deserializer) == hashed);
+
+            // Flat maps iterate in the same order. Hash maps are only sorted by canonical encodings.
+            auto encode = [](const auto &value) {{
+                auto serializer = serde::{3}Serializer();
+                serde::Serializable<std::decay_t<decltype(value)>>::serialize(value, serializer);
+                return std::move(serializer).bytes();
+            }};
+            assert(encode(flat) == bytes);
+            if (serde::{3}Serializer::enforce_strict_map_ordering) {{
+                assert(encode(hashed) == bytes);
+            }}
+        }}
+
+        // Large lengths are rejected without running out of memory.
+        {{
+            auto serializer = serde::{3}Serializer();
+            serializer.serialize_len(1 << 30);
+            auto deserializer = serde::{3}Deserializer(std::move(serializer).bytes());
+            try {{
+                serde::Deserializable<std::vector<std::string>>::deserialize(deserializer);
+                assert(false);
+            }} catch (serde::deserialization_error e) {{
+                // All good
+            }}
+        }}
+
         for (auto input: negative_inputs) {{
+            try {{
+                if (SerdeData::{2}TryDeserialize(input.data(), input.size())) {{
+                    printf("Input should fail to deserialize without exceptions\n");
+                    assert(false);
+                }}
+                if (SerdeData::{2}Validate(input.data(), input.size()) == input.size()) {{
+                    printf("Input should fail to be validated\n");
+                    assert(false);
+                }}
+            }} catch (serde::deserialization_error e) {{
+                // All good
+            }}
             try {{
                 SerdeData::{2}Deserialize(input);
                 printf("Input should fail to deserialize:");
@@ -208,6 +433,7 @@ int main() {{
         positive_encodings.join(", "),
         negative_encodings.join(", "),
         runtime.name(),
+        runtime.name().to_camel_case(),
     )
     .unwrap();
 
@@ -215,6 +441,1034 @@ int main() {{
         .arg("--std=c++17")
         .arg("-g")
         .arg("-O3") // remove for debugging
+        .arg("-pthread")
+        .arg("-o")
+        .arg(dir.path().join("test"))
+        .arg("-I")
+        .arg("runtime/cpp")
+        .arg(source_path)
+        .status()
+        .unwrap();
+    assert!(status.success());
+
+    let status = Command::new(dir.path().join("test")).status().unwrap();
+    assert!(status.success());
+}
+
+#[test]
+fn test_cpp_runtime_with_polymorphic_allocators() {
+    let runtime = Runtime::Bcs;
+    let registry = test_utils::get_registry().unwrap();
+    let dir = tempdir().unwrap();
+    let header_path = dir.path().join("test.hpp");
+    let mut header = File::create(&header_path).unwrap();
+
+    let config = CodeGeneratorConfig::new("testing".to_string())
+        .with_encodings(vec![runtime.into()])
+        .with_polymorphic_allocators(true);
+    let generator = cpp::CodeGenerator::new(&config);
+    generator.output(&mut header, &registry).unwrap();
+
+    let positive_encodings: Vec<_> = runtime
+        .get_positive_samples()
+        .iter()
+        .map(|bytes| quote_bytes(bytes))
+        .collect();
+
+    let source_path = dir.path().join("test.cpp");
+    let mut source = File::create(&source_path).unwrap();
+    writeln!(
+        source,
+        r#"
+#include <cassert>
+#include <memory_resource>
+#include "test.hpp"
+
+using namespace testing;
+
+int main() {{
+    std::vector<std::vector<uint8_t>> positive_inputs = {{{0}}};
+    static uint8_t buffer[1 << 20];
+    for (auto input: positive_inputs) {{
+        std::pmr::monotonic_buffer_resource arena(
+            buffer, sizeof(buffer), std::pmr::null_memory_resource());
+        // Every allocation made while decoding must come from the arena.
+        auto previous = std::pmr::set_default_resource(std::pmr::null_memory_resource());
+        auto value = SerdeData::{1}Deserialize(input, &arena);
+        std::pmr::set_default_resource(previous);
+
+        auto output = value.{1}Serialize();
+        assert(input == output);
+    }}
+    return 0;
+}}
+"#,
+        positive_encodings.join(", "),
+        runtime.name(),
+    )
+    .unwrap();
+
+    let status = Command::new("clang++")
+        .arg("--std=c++17")
+        .arg("-o")
+        .arg(dir.path().join("test"))
+        .arg("-I")
+        .arg("runtime/cpp")
+        .arg(source_path)
+        .status()
+        .unwrap();
+    assert!(status.success());
+
+    let status = Command::new(dir.path().join("test")).status().unwrap();
+    assert!(status.success());
+}
+
+#[test]
+fn test_cpp_bcs_runtime_without_exceptions() {
+    test_cpp_runtime_without_exceptions(Runtime::Bcs);
+}
+
+#[test]
+fn test_cpp_bincode_runtime_without_exceptions() {
+    test_cpp_runtime_without_exceptions(Runtime::Bincode);
+}
+
+fn test_cpp_runtime_without_exceptions(runtime: Runtime) {
+    let registry = test_utils::get_registry().unwrap();
+    let dir = tempdir().unwrap();
+    let header_path = dir.path().join("test.hpp");
+    let mut header = File::create(&header_path).unwrap();
+
+    let config =
+        CodeGeneratorConfig::new("testing".to_string()).with_encodings(vec![runtime.into()]);
+    let generator = cpp::CodeGenerator::new(&config);
+    generator.output(&mut header, &registry).unwrap();
+
+    let positive_encodings: Vec<_> = runtime
+        .get_positive_samples()
+        .iter()
+        .map(|bytes| quote_bytes(bytes))
+        .collect();
+
+    let negative_encodings: Vec<_> = runtime
+        .get_negative_samples()
+        .iter()
+        .map(|bytes| quote_bytes(bytes))
+        .collect();
+
+    let source_path = dir.path().join("test.cpp");
+    let mut source = File::create(&source_path).unwrap();
+    writeln!(
+        source,
+        r#"
+#include <cassert>
+#include <cstdio>
+#include "test.hpp"
+
+using namespace testing;
+
+int main() {{
+    std::vector<std::vector<uint8_t>> positive_inputs = {{{0}}};
+    std::vector<std::vector<uint8_t>> negative_inputs = {{{1}}};
+    for (auto input: positive_inputs) {{
+        auto result = SerdeData::{2}TryDeserialize(input.data(), input.size());
+        assert(result);
+        assert(result->{2}Serialize() == input);
+
+        // Mutated inputs are either rejected or decode to a different value.
+        for (size_t i = 0; i < std::min(input.size(), (size_t)20); i++) {{
+            auto input2 = input;
+            input2[i] ^= 0x81;
+            auto result2 = SerdeData::{2}TryDeserialize(input2.data(), input2.size());
+            assert(!result2 || !(*result2 == *result));
+        }}
+
+        // Truncated inputs report where the input ended.
+        result = SerdeData::{2}TryDeserialize(input.data(), input.size() - 1);
+        assert(!result);
+        assert(result.error().code == serde::deserialization_errc::input_too_short);
+        assert(result.error().offset <= input.size() - 1);
+    }}
+    for (auto input: negative_inputs) {{
+        auto result = SerdeData::{2}TryDeserialize(input.data(), input.size());
+        if (result) {{
+            printf("Input should fail to deserialize\n");
+            return 1;
+        }}
+    }}
+    return 0;
+}}
+"#,
+        positive_encodings.join(", "),
+        negative_encodings.join(", "),
+        runtime.name(),
+    )
+    .unwrap();
+
+    let status = Command::new("clang++")
+        .arg("--std=c++17")
+        .arg("-fno-exceptions")
+        .arg("-o")
+        .arg(dir.path().join("test"))
+        .arg("-I")
+        .arg("runtime/cpp")
+        .arg(source_path)
+        .status()
+        .unwrap();
+    assert!(status.success());
+
+    let status = Command::new(dir.path().join("test")).status().unwrap();
+    assert!(status.success());
+}
+
+#[test]
+fn test_cpp_runtime_on_record_file() {
+    let runtime = Runtime::Bcs;
+    let registry = test_utils::get_registry().unwrap();
+    let dir = tempdir().unwrap();
+    let header_path = dir.path().join("test.hpp");
+    let mut header = File::create(&header_path).unwrap();
+
+    let config =
+        CodeGeneratorConfig::new("testing".to_string()).with_encodings(vec![runtime.into()]);
+    let generator = cpp::CodeGenerator::new(&config);
+    generator.output(&mut header, &registry).unwrap();
+
+    let positive_encodings: Vec<_> = runtime
+        .get_positive_samples()
+        .iter()
+        .map(|bytes| quote_bytes(bytes))
+        .collect();
+
+    let source_path = dir.path().join("test.cpp");
+    let mut source = File::create(&source_path).unwrap();
+    writeln!(
+        source,
+        r#"
+#include <cassert>
+#include <fstream>
+#include "mmap.hpp"
+#include "test.hpp"
+
+using namespace testing;
+
+int main() {{
+    std::vector<std::vector<uint8_t>> positive_inputs = {{{0}}};
+    const char *path = "{1}";
+    {{
+        std::ofstream stream(path, std::ios::binary);
+        serde::OstreamSink sink(stream);
+        for (auto input: positive_inputs) {{
+            write_record(sink, SerdeData::{2}Deserialize(input).{2}Serialize());
+        }}
+    }}
+
+    serde::MappedFile file(path);
+    serde::RecordReader reader(file.data(), file.size());
+    size_t count = 0;
+    while (auto record = reader.next()) {{
+        auto value = SerdeData::{2}Deserialize(record->data, record->size);
+        assert(value.{2}Serialize() == positive_inputs[count]);
+        count++;
+    }}
+    assert(count == positive_inputs.size());
+    assert(reader.get_buffer_offset() == file.size());
+    return 0;
+}}
+"#,
+        positive_encodings.join(", "),
+        dir.path().join("records.bin").to_str().unwrap(),
+        runtime.name(),
+    )
+    .unwrap();
+
+    let status = Command::new("clang++")
+        .arg("--std=c++17")
+        .arg("-o")
+        .arg(dir.path().join("test"))
+        .arg("-I")
+        .arg("runtime/cpp")
+        .arg(source_path)
+        .status()
+        .unwrap();
+    assert!(status.success());
+
+    let status = Command::new(dir.path().join("test")).status().unwrap();
+    assert!(status.success());
+}
+
+#[test]
+fn test_cpp_runtime_utf8_validation() {
+    let dir = tempdir().unwrap();
+    let source_path = dir.path().join("test.cpp");
+    let mut source = File::create(&source_path).unwrap();
+    writeln!(
+        source,
+        r#"
+#include <cassert>
+#include <string>
+#include "binary.hpp"
+
+using serde::is_valid_utf8;
+
+int main() {{
+    // Short strings use the scalar validator, longer ones the vectorized one (if available).
+    for (std::string padding : {{"", "0123456789abcdefghijklmnopqrstuvwxyz"}}) {{
+        assert(is_valid_utf8(padding + "h\xc3\xa9llo \xe2\x82\xac \xf0\x9f\x98\x80"));
+        assert(is_valid_utf8(padding + "\xed\x9f\xbf\xee\x80\x80\xf4\x8f\xbf\xbf"));
+        // Truncated sequences.
+        assert(!is_valid_utf8(padding + "\xc3"));
+        assert(!is_valid_utf8(padding + "\xe2\x82"));
+        assert(!is_valid_utf8(padding + "\xf0\x9f\x98" + padding));
+        // Unexpected continuation bytes.
+        assert(!is_valid_utf8(padding + "\x80"));
+        assert(!is_valid_utf8(padding + "\xc3\xa9\xa9"));
+        // Overlong encodings.
+        assert(!is_valid_utf8(padding + "\xc0\xaf"));
+        assert(!is_valid_utf8(padding + "\xe0\x80\xaf"));
+        assert(!is_valid_utf8(padding + "\xf0\x80\x80\xaf"));
+        // Surrogates and code points above U+10FFFF.
+        assert(!is_valid_utf8(padding + "\xed\xa0\x80"));
+        assert(!is_valid_utf8(padding + "\xf4\x90\x80\x80"));
+        assert(!is_valid_utf8(padding + "\xf8\x88\x80\x80\x80"));
+    }}
+    return 0;
+}}
+"#
+    )
+    .unwrap();
+
+    let mut flags = vec![vec![]];
+    if cfg!(target_arch = "x86_64") {
+        flags.push(vec!["-mssse3"]);
+    }
+    for extra_flags in flags {
+        let status = Command::new("clang++")
+            .arg("--std=c++17")
+            .args(extra_flags)
+            .arg("-o")
+            .arg(dir.path().join("test"))
+            .arg("-I")
+            .arg("runtime/cpp")
+            .arg(&source_path)
+            .status()
+            .unwrap();
+        assert!(status.success());
+
+        let status = Command::new(dir.path().join("test")).status().unwrap();
+        assert!(status.success());
+    }
+}
+
+#[test]
+fn test_cpp_runtime_bcs_uleb128() {
+    let dir = tempdir().unwrap();
+    let source_path = dir.path().join("test.cpp");
+    let mut source = File::create(&source_path).unwrap();
+    writeln!(
+        source,
+        r#"
+#include <cassert>
+#include <vector>
+#include "bcs.hpp"
+
+using namespace serde;
+
+deserialization_failure decode(std::vector<uint8_t> bytes, uint32_t *value) {{
+    auto deserializer = BcsDeserializer(bytes);
+    deserializer.set_throw_on_error(false);
+    *value = deserializer.deserialize_variant_index();
+    auto failure = deserializer.get_failure();
+    if (failure.code == deserialization_errc::ok) {{
+        failure.offset = deserializer.get_buffer_offset();
+    }}
+    return failure;
+}}
+
+// Same as `decode`, pulling the input from a source by chunks of `chunk` bytes.
+deserialization_failure decode_chunks(std::vector<uint8_t> bytes, size_t chunk, uint32_t *value) {{
+    size_t pos = 0;
+    auto deserializer = BcsDeserializer(Source([&](uint8_t *buffer, size_t len) -> size_t {{
+        size_t count = std::min({{chunk, len, bytes.size() - pos}});
+        std::copy(bytes.begin() + pos, bytes.begin() + pos + count, buffer);
+        pos += count;
+        return count;
+    }}));
+    deserializer.set_throw_on_error(false);
+    *value = deserializer.deserialize_variant_index();
+    return deserializer.get_failure();
+}}
+
+int main() {{
+    // Invalid encodings fail with the same error and offset, whether they are
+    // decoded from a word or byte by byte from a source.
+    for (std::vector<uint8_t> bytes : std::vector<std::vector<uint8_t>>{{
+             {{0x80, 0x80, 0x80, 0x80, 0x80, 0x01}},
+             {{0x80, 0x00}},
+             {{0xff, 0xff, 0xff, 0xff, 0x00}},
+             {{0xff, 0xff, 0xff, 0xff, 0x10}}}}) {{
+        // Trailing bytes let the word path apply to the buffered input.
+        std::vector<uint8_t> padded = bytes;
+        padded.insert(padded.end(), 8, 0xff);
+        uint32_t value;
+        auto expected = decode(padded, &value);
+        assert(expected.code != deserialization_errc::ok && expected.offset == 0);
+        for (size_t chunk : {{1, 2, 3}}) {{
+            auto failure = decode_chunks(bytes, chunk, &value);
+            assert(failure.code == expected.code && failure.offset == expected.offset);
+        }}
+    }}
+
+    // Inputs followed by other bytes are decoded from a word, the others byte by byte.
+    for (size_t padding : {{0, 8}}) {{
+        std::vector<uint8_t> trailer(padding, 0xff);
+        for (uint32_t expected : {{0u, 1u, 0x7fu, 0x80u, 0x3fffu, 0x4000u, 0x1fffffu, 0x200000u,
+                                   0xfffffffu, 0x10000000u, 0xffffffffu}}) {{
+            auto serializer = BcsSerializer();
+            serializer.serialize_variant_index(expected);
+            auto bytes = std::move(serializer).bytes();
+            size_t len = bytes.size();
+            bytes.insert(bytes.end(), trailer.begin(), trailer.end());
+            uint32_t value;
+            auto failure = decode(bytes, &value);
+            assert(failure.code == deserialization_errc::ok);
+            assert(value == expected && failure.offset == len);
+        }}
+
+        uint32_t value;
+        auto with_trailer = [&](std::vector<uint8_t> bytes) {{
+            bytes.insert(bytes.end(), trailer.begin(), trailer.end());
+            return bytes;
+        }};
+        // Non-canonical encodings.
+        assert(decode(with_trailer({{0x80, 0x00}}), &value).code == deserialization_errc::invalid_uleb128);
+        assert(decode(with_trailer({{0xff, 0xff, 0xff, 0xff, 0x00}}), &value).code == deserialization_errc::invalid_uleb128);
+        // Values above 2^32 - 1 and encodings longer than 5 bytes.
+        assert(decode(with_trailer({{0xff, 0xff, 0xff, 0xff, 0x10}}), &value).code == deserialization_errc::uleb128_overflow);
+        assert(decode(with_trailer({{0x80, 0x80, 0x80, 0x80, 0x80, 0x01}}), &value).code == deserialization_errc::uleb128_overflow);
+    }}
+    // Truncated encodings.
+    uint32_t value;
+    assert(decode({{0x80, 0x80}}, &value).code == deserialization_errc::input_too_short);
+    return 0;
+}}
+"#
+    )
+    .unwrap();
+
+    let status = Command::new("clang++")
+        .arg("--std=c++17")
+        .arg("-o")
+        .arg(dir.path().join("test"))
+        .arg("-I")
+        .arg("runtime/cpp")
+        .arg(&source_path)
+        .status()
+        .unwrap();
+    assert!(status.success());
+
+    let status = Command::new(dir.path().join("test")).status().unwrap();
+    assert!(status.success());
+}
+
+#[test]
+fn test_cpp_runtime_bcs_sink_output_limit() {
+    let dir = tempdir().unwrap();
+    let source_path = dir.path().join("test.cpp");
+    let mut source = File::create(&source_path).unwrap();
+    writeln!(
+        source,
+        r#"
+#include <cassert>
+#include <sstream>
+#include "bcs.hpp"
+
+using namespace serde;
+
+using StreamSerializer = BasicBcsSerializer<SinkOutput<OstreamSink>>;
+
+int main() {{
+    std::map<std::string, uint32_t> map;
+    for (uint32_t i = 0; i < 100; i++) {{
+        map.emplace(std::to_string(i), i);
+    }}
+    auto reference = BcsSerializer();
+    Serializable<decltype(map)>::serialize(map, reference);
+    auto bytes = std::move(reference).bytes();
+
+    // The entries of a map are held in memory until they are sorted, up to
+    // the maximal capacity of the output.
+    {{
+        std::ostringstream stream;
+        auto serializer = StreamSerializer(SinkOutput<OstreamSink>(OstreamSink(stream), 16, 1024));
+        Serializable<decltype(map)>::serialize(map, serializer);
+        serializer.output().flush();
+        auto output = stream.str();
+        assert(std::vector<uint8_t>(output.begin(), output.end()) == bytes);
+    }}
+    {{
+        std::ostringstream stream;
+        auto serializer = StreamSerializer(SinkOutput<OstreamSink>(OstreamSink(stream), 16, 64));
+        bool thrown = false;
+        try {{
+            Serializable<decltype(map)>::serialize(map, serializer);
+        }} catch (const serialization_error &) {{
+            thrown = true;
+        }}
+        assert(thrown);
+    }}
+    return 0;
+}}
+"#
+    )
+    .unwrap();
+
+    let status = Command::new("clang++")
+        .arg("--std=c++17")
+        .arg("-o")
+        .arg(dir.path().join("test"))
+        .arg("-I")
+        .arg("runtime/cpp")
+        .arg(&source_path)
+        .status()
+        .unwrap();
+    assert!(status.success());
+
+    let status = Command::new(dir.path().join("test")).status().unwrap();
+    assert!(status.success());
+}
+
+#[test]
+fn test_cpp_runtime_dynamic_codec() {
+    let registry = test_utils::get_registry().unwrap();
+    let registry_encoding = Runtime::Bcs.serialize(&registry);
+    let values = test_utils::get_sample_values(/* has_canonical_maps */ true, false);
+    let bcs_encodings: Vec<_> = values
+        .iter()
+        .map(|value| quote_bytes(&Runtime::Bcs.serialize(value)))
+        .collect();
+    let bincode_encodings: Vec<_> = values
+        .iter()
+        .map(|value| quote_bytes(&Runtime::Bincode.serialize(value)))
+        .collect();
+    let negative_encodings: Vec<_> = Runtime::Bcs
+        .get_negative_samples()
+        .iter()
+        .map(|bytes| quote_bytes(bytes))
+        .collect();
+
+    let dir = tempdir().unwrap();
+    let source_path = dir.path().join("test.cpp");
+    let mut source = File::create(&source_path).unwrap();
+    writeln!(
+        source,
+        r#"
+#include <cassert>
+#include <stdexcept>
+#include "bcs.hpp"
+#include "bincode.hpp"
+#include "dynamic.hpp"
+
+using namespace serde;
+
+template <typename Deserializer, typename Serializer>
+std::vector<uint8_t> transcode(const dynamic::Codec &codec, uint32_t type, const std::vector<uint8_t> &input) {{
+    auto deserializer = Deserializer(input);
+    auto serializer = Serializer();
+    codec.transcode(type, deserializer, serializer);
+    assert(deserializer.get_buffer_offset() == input.size());
+    return std::move(serializer).bytes();
+}}
+
+int main() {{
+    std::vector<uint8_t> registry_encoding = {0};
+    std::vector<std::vector<uint8_t>> bcs_inputs = {{{1}}};
+    std::vector<std::vector<uint8_t>> bincode_inputs = {{{2}}};
+    std::vector<std::vector<uint8_t>> negative_inputs = {{{3}}};
+
+    auto codec = dynamic::Codec(dynamic::deserialize_registry<BcsDeserializer>(
+        registry_encoding.data(), registry_encoding.size()));
+    auto type = codec.type_index("SerdeData");
+    assert(codec.type_index("SerdeData") == type);
+
+    for (size_t i = 0; i < bcs_inputs.size(); i++) {{
+        const auto &bcs = bcs_inputs[i];
+        const auto &bincode = bincode_inputs[i];
+        assert(codec.validate<BcsDeserializer>(type, bcs.data(), bcs.size()) == bcs.size());
+        assert(codec.validate<BincodeDeserializer>(type, bincode.data(), bincode.size()) == bincode.size());
+        // BCS sorts the entries of maps.
+        assert((transcode<BincodeDeserializer, BcsSerializer>(codec, type, bincode) == bcs));
+        auto converted = transcode<BcsDeserializer, BincodeSerializer>(codec, type, bcs);
+        assert((transcode<BincodeDeserializer, BcsSerializer>(codec, type, converted) == bcs));
+        assert((transcode<BcsDeserializer, BcsSerializer>(codec, type, bcs) == bcs));
+    }}
+
+    for (const auto &input : negative_inputs) {{
+        auto deserializer = BcsDeserializer(input);
+        deserializer.set_throw_on_error(false);
+        codec.skip(type, deserializer);
+        assert(deserializer.has_failed() || deserializer.get_buffer_offset() < input.size());
+    }}
+
+    // Fields are found without decoding the rest of the value.
+    auto path = codec.field_path("SerdeData", {{"PrimitiveTypes", "0", "f_u64"}});
+    const auto &input = bcs_inputs[0];
+    auto field = codec.find<BcsDeserializer>(path, input.data(), input.size());
+    assert(field && field->size == 8);
+    auto deserializer = BcsDeserializer(field->data, field->size);
+    assert(deserializer.deserialize_u64() == 3);
+    // Values of other variants have no such field.
+    const auto &other_input = bcs_inputs[2];
+    assert(!codec.find<BcsDeserializer>(path, other_input.data(), other_input.size()));
+
+    try {{
+        codec.field_path("SerdeData", {{"PrimitiveTypes", "0", "f_u64", "x"}});
+        assert(false);
+    }} catch (const std::invalid_argument &) {{}}
+    return 0;
+}}
+"#,
+        quote_bytes(&registry_encoding),
+        bcs_encodings.join(", "),
+        bincode_encodings.join(", "),
+        negative_encodings.join(", "),
+    )
+    .unwrap();
+
+    let status = Command::new("clang++")
+        .arg("--std=c++17")
+        .arg("-o")
+        .arg(dir.path().join("test"))
+        .arg("-I")
+        .arg("runtime/cpp")
+        .arg(&source_path)
+        .status()
+        .unwrap();
+    assert!(status.success());
+
+    let status = Command::new(dir.path().join("test")).status().unwrap();
+    assert!(status.success());
+}
+
+#[test]
+fn test_cpp_runtime_bincode_configurations() {
+    use bincode::Options;
+
+    let registry = test_utils::get_registry().unwrap();
+    let dir = tempdir().unwrap();
+    let header_path = dir.path().join("test.hpp");
+    let mut header = File::create(&header_path).unwrap();
+
+    let config = CodeGeneratorConfig::new("testing".to_string()).with_encodings(vec![
+        Encoding::Bincode,
+        Encoding::BincodeVarint,
+        Encoding::BincodeBigEndian,
+        Encoding::BincodeVarintBigEndian,
+    ]);
+    let generator = cpp::CodeGenerator::new(&config);
+    generator.output(&mut header, &registry).unwrap();
+
+    let values = test_utils::get_sample_values(
+        /* has_canonical_maps */ true, /* has_floats */ true,
+    );
+    let encode = |serialize: &dyn Fn(&test_utils::SerdeData) -> Vec<u8>| {
+        values
+            .iter()
+            .map(|value| quote_bytes(&serialize(value)))
+            .collect::<Vec<_>>()
+            .join(", ")
+    };
+    let fixint_encodings = encode(&|value| bincode::serialize(value).unwrap());
+    let varint_encodings = encode(&|value| bincode::options().serialize(value).unwrap());
+    let big_endian_encodings = encode(&|value| {
+        bincode::options()
+            .with_fixint_encoding()
+            .with_big_endian()
+            .serialize(value)
+            .unwrap()
+    });
+    let varint_big_endian_encodings = encode(&|value| {
+        bincode::options()
+            .with_big_endian()
+            .serialize(value)
+            .unwrap()
+    });
+
+    let source_path = dir.path().join("test.cpp");
+    let mut source = File::create(&source_path).unwrap();
+    writeln!(
+        source,
+        r#"
+#include <cassert>
+#include "test.hpp"
+
+using namespace testing;
+
+template <typename Deserialize, typename Serialize, typename Validate>
+size_t check(const SerdeData &value, const std::vector<uint8_t> &input, Deserialize deserialize, Serialize serialize, Validate validate) {{
+    assert(deserialize(input) == value);
+    assert(serialize(value) == input);
+    assert(validate(input.data(), input.size()) == input.size());
+    try {{
+        deserialize(std::vector<uint8_t>(input.begin(), input.end() - 1));
+        assert(false);
+    }} catch (const serde::deserialization_error &) {{}}
+    return input.size();
+}}
+
+int main() {{
+    std::vector<std::vector<uint8_t>> fixint_inputs = {{{0}}};
+    std::vector<std::vector<uint8_t>> varint_inputs = {{{1}}};
+    std::vector<std::vector<uint8_t>> big_endian_inputs = {{{2}}};
+    std::vector<std::vector<uint8_t>> varint_big_endian_inputs = {{{3}}};
+
+    size_t fixint_size = 0;
+    size_t varint_size = 0;
+    for (size_t i = 0; i < fixint_inputs.size(); i++) {{
+        auto value = SerdeData::bincodeDeserialize(fixint_inputs[i]);
+        fixint_size += check(value, fixint_inputs[i],
+            [](const auto &input) {{ return SerdeData::bincodeDeserialize(input); }},
+            [](const auto &value) {{ return value.bincodeSerialize(); }},
+            &SerdeData::bincodeValidate);
+        varint_size += check(value, varint_inputs[i],
+            [](const auto &input) {{ return SerdeData::bincodeVarintDeserialize(input); }},
+            [](const auto &value) {{ return value.bincodeVarintSerialize(); }},
+            &SerdeData::bincodeVarintValidate);
+        check(value, big_endian_inputs[i],
+            [](const auto &input) {{ return SerdeData::bincodeBigEndianDeserialize(input); }},
+            [](const auto &value) {{ return value.bincodeBigEndianSerialize(); }},
+            &SerdeData::bincodeBigEndianValidate);
+        check(value, varint_big_endian_inputs[i],
+            [](const auto &input) {{ return SerdeData::bincodeVarintBigEndianDeserialize(input); }},
+            [](const auto &value) {{ return value.bincodeVarintBigEndianSerialize(); }},
+            &SerdeData::bincodeVarintBigEndianValidate);
+        assert(serde::BincodeVarintSerializer::serialized_size(value) == varint_inputs[i].size());
+    }}
+    assert(varint_size < fixint_size);
+
+    // Varints are range-checked against the type being decoded.
+    std::vector<uint8_t> input = {{252, 0, 0, 1, 0}};
+    auto deserializer = serde::BincodeVarintDeserializer(input);
+    deserializer.set_throw_on_error(false);
+    deserializer.deserialize_u16();
+    assert(deserializer.get_failure().code == serde::deserialization_errc::varint_overflow);
+    return 0;
+}}
+"#,
+        fixint_encodings, varint_encodings, big_endian_encodings, varint_big_endian_encodings,
+    )
+    .unwrap();
+
+    let status = Command::new("clang++")
+        .arg("--std=c++17")
+        .arg("-o")
+        .arg(dir.path().join("test"))
+        .arg("-I")
+        .arg("runtime/cpp")
+        .arg(&source_path)
+        .status()
+        .unwrap();
+    assert!(status.success());
+
+    let status = Command::new(dir.path().join("test")).status().unwrap();
+    assert!(status.success());
+}
+
+#[test]
+fn test_cpp_runtime_with_instrumentation() {
+    let runtime = Runtime::Bcs;
+    let registry = test_utils::get_simple_registry().unwrap();
+    let dir = tempdir().unwrap();
+    let header_path = dir.path().join("test.hpp");
+    let mut header = File::create(&header_path).unwrap();
+
+    let config =
+        CodeGeneratorConfig::new("testing".to_string()).with_encodings(vec![runtime.into()]);
+    let generator = cpp::CodeGenerator::new(&config);
+    generator.output(&mut header, &registry).unwrap();
+
+    let reference = runtime.serialize(&Test {
+        a: vec![4, 6],
+        b: (-3, 5),
+        c: Choice::C { x: 7 },
+    });
+
+    let source_path = dir.path().join("test.cpp");
+    let mut source = File::create(&source_path).unwrap();
+    writeln!(
+        source,
+        r#"
+#define SERDE_INSTRUMENTATION 1
+#include <cassert>
+#include <string>
+#include "test.hpp"
+
+using namespace testing;
+
+static std::map<std::string, size_t> calls;
+
+void count_call(const char *type_name, const char *operation,
+                std::chrono::nanoseconds) {{
+    calls[std::string(type_name) + "/" + operation]++;
+}}
+
+int main() {{
+    std::vector<uint8_t> input = {{{0}}};
+    serde::set_type_timing_hook(count_call);
+
+    auto value = Test::bcsDeserialize(input);
+    auto &counters = serde::thread_counters();
+    assert(counters.bytes_read == input.size());
+    assert(counters.max_depth == 2);
+    assert(calls["testing::Test/deserialize"] == 1);
+    assert(calls["testing::Choice::C/deserialize"] == 1);
+
+    serde::thread_counters() = {{}};
+    assert(value.bcsSerialize() == input);
+    assert(counters.bytes_written == input.size());
+    assert(calls["testing::Choice/serialize"] >= 1);
+
+    // Decoding into a value of the same shape does not allocate.
+    Test reused;
+    reused.bcsDeserializeInto(input);
+    serde::thread_counters() = {{}};
+    reused.bcsDeserializeInto(input);
+    assert(reused == value);
+    assert(counters.allocations == 0);
+
+    serde::thread_counters() = {{}};
+    std::map<std::string, uint64_t> map = {{{{"a", 1}}, {{"bb", 2}}, {{"c", 3}}}};
+    auto serializer = serde::BcsSerializer();
+    serde::Serializable<decltype(map)>::serialize(map, serializer);
+    assert(counters.map_entries_sorted == 3);
+    auto bytes = std::move(serializer).bytes();
+    auto deserializer = serde::BcsDeserializer(bytes);
+    assert(serde::Deserializable<decltype(map)>::deserialize(deserializer) == map);
+    assert(counters.map_keys_checked == 2);
+    assert(counters.strings_validated == 3);
+    assert(counters.allocations == 3);
+    return 0;
+}}
+"#,
+        reference
+            .iter()
+            .map(|x| format!("0x{:02x}", x))
+            .collect::<Vec<_>>()
+            .join(", "),
+    )
+    .unwrap();
+
+    let status = Command::new("clang++")
+        .arg("--std=c++17")
+        .arg("-o")
+        .arg(dir.path().join("test"))
+        .arg("-I")
+        .arg("runtime/cpp")
+        .arg(source_path)
+        .status()
+        .unwrap();
+    assert!(status.success());
+
+    let status = Command::new(dir.path().join("test")).status().unwrap();
+    assert!(status.success());
+}
+
+#[test]
+fn test_cpp_runtime_value_ptr_construction() {
+    let dir = tempdir().unwrap();
+    let source_path = dir.path().join("test.cpp");
+    let mut source = File::create(&source_path).unwrap();
+    writeln!(
+        source,
+        r#"
+#include <cassert>
+#include "bcs.hpp"
+
+// Counts the copies and moves of decoded values.
+struct Counted {{
+    static inline int copies = 0;
+    static inline int moves = 0;
+    uint8_t value;
+
+    explicit Counted(uint8_t value) : value(value) {{}}
+    Counted(const Counted &other) : value(other.value) {{ copies++; }}
+    Counted(Counted &&other) : value(other.value) {{ moves++; }}
+}};
+
+template <>
+struct serde::Deserializable<Counted> {{
+    template <typename Deserializer>
+    static Counted deserialize(Deserializer &deserializer) {{
+        return Counted(deserializer.deserialize_u8());
+    }}
+}};
+
+int main() {{
+    std::vector<uint8_t> input = {{7}};
+    auto deserializer = serde::BcsDeserializer(input);
+    auto ptr = serde::Deserializable<serde::value_ptr<Counted>>::deserialize(deserializer);
+    assert(ptr->value == 7);
+    assert(Counted::copies == 0 && Counted::moves == 0);
+
+    auto other = serde::value_ptr<Counted>(std::in_place, {{}}, 8);
+    assert(other->value == 8);
+    assert(Counted::copies == 0 && Counted::moves == 0);
+    return 0;
+}}
+"#
+    )
+    .unwrap();
+
+    let status = Command::new("clang++")
+        .arg("--std=c++17")
+        .arg("-o")
+        .arg(dir.path().join("test"))
+        .arg("-I")
+        .arg("runtime/cpp")
+        .arg(source_path)
+        .status()
+        .unwrap();
+    assert!(status.success());
+
+    let status = Command::new(dir.path().join("test")).status().unwrap();
+    assert!(status.success());
+}
+
+// A sequence nested in a container.
+#[derive(Deserialize)]
+#[allow(dead_code)]
+struct Row {
+    cells: Vec<String>,
+}
+
+#[test]
+fn test_cpp_runtime_parallel_sequences() {
+    let mut tracer = Tracer::new(TracerConfig::default());
+    tracer.trace_simple_type::<Row>().unwrap();
+    let registry = tracer.registry().unwrap();
+    let dir = tempdir().unwrap();
+    let header_path = dir.path().join("test.hpp");
+    let mut header = File::create(&header_path).unwrap();
+
+    let config =
+        CodeGeneratorConfig::new("testing".to_string()).with_encodings(vec![Encoding::Bcs]);
+    let generator = cpp::CodeGenerator::new(&config);
+    generator.output(&mut header, &registry).unwrap();
+
+    let source_path = dir.path().join("test.cpp");
+    let mut source = File::create(&source_path).unwrap();
+    writeln!(
+        source,
+        r#"
+#include <atomic>
+#include <cassert>
+#include <stdexcept>
+#include "test.hpp"
+
+using namespace testing;
+
+// Byte whose decoding throws on 0xff, but which is skipped without checks.
+struct Checked {{
+    uint8_t value;
+}};
+
+template <>
+struct serde::Deserializable<Checked> {{
+    template <typename Deserializer>
+    static Checked deserialize(Deserializer &deserializer) {{
+        uint8_t value = deserializer.deserialize_u8();
+        if (value == 0xff) {{
+            throw std::runtime_error("rejected");
+        }}
+        return Checked{{value}};
+    }}
+}};
+
+template <>
+struct serde::Skippable<Checked> {{
+    template <typename Deserializer>
+    static void skip(Deserializer &deserializer) {{
+        deserializer.deserialize_u8();
+    }}
+}};
+
+int main() {{
+    // Exceptions of tasks are rethrown once all threads are joined, whether
+    // they were thrown by the calling thread or by a worker.
+    for (size_t failing : {{0, 5, 63}}) {{
+        std::atomic<size_t> completed{{0}};
+        bool thrown = false;
+        try {{
+            serde::thread_executor(4)(64, [&](size_t i) {{
+                if (i == failing) {{
+                    throw std::runtime_error("task");
+                }}
+                completed++;
+            }});
+        }} catch (const std::runtime_error &) {{
+            thrown = true;
+        }}
+        assert(thrown && completed < 64);
+    }}
+
+    // Exceptions thrown while decoding elements in parallel reach the caller.
+    std::vector<uint8_t> input = {{0xc8, 0x01}};
+    input.resize(input.size() + 200, 1);
+    {{
+        auto deserializer = serde::BcsDeserializer(input);
+        deserializer.set_parallel_executor(serde::thread_executor(4), SIZE_MAX, 1);
+        auto values = serde::Deserializable<std::vector<Checked>>::deserialize(deserializer);
+        assert(values.size() == 200 && values[150].value == 1);
+    }}
+    input[2 + 150] = 0xff;
+    {{
+        auto deserializer = serde::BcsDeserializer(input);
+        deserializer.set_parallel_executor(serde::thread_executor(4), SIZE_MAX, 1);
+        bool thrown = false;
+        try {{
+            serde::Deserializable<std::vector<Checked>>::deserialize(deserializer);
+        }} catch (const std::runtime_error &) {{
+            thrown = true;
+        }}
+        assert(thrown);
+    }}
+
+    // Only sequences nested in at most `max_depth` containers are split, even
+    // when the depth budget would let the generated code skip tracking them.
+    size_t calls = 0;
+    serde::Executor counting = [&](size_t count, const std::function<void(size_t)> &task) {{
+        calls++;
+        for (size_t i = 0; i < count; i++) {{
+            task(i);
+        }}
+    }};
+    std::vector<Row> rows(2, Row{{std::vector<std::string>(8, "cell")}});
+    auto reference = serde::BcsSerializer();
+    serde::Serializable<std::vector<Row>>::serialize(rows, reference);
+    auto bytes = std::move(reference).bytes();
+    for (size_t max_depth : {{0, 1}}) {{
+        calls = 0;
+        auto serializer = serde::BcsSerializer();
+        serializer.set_parallel_executor(counting, max_depth, 4);
+        serde::Serializable<std::vector<Row>>::serialize(rows, serializer);
+        assert(std::move(serializer).bytes() == bytes);
+        assert(calls == (max_depth == 0 ? 0 : rows.size()));
+
+        calls = 0;
+        auto deserializer = serde::BcsDeserializer(bytes);
+        deserializer.set_parallel_executor(counting, max_depth, 4);
+        assert(serde::Deserializable<std::vector<Row>>::deserialize(deserializer) == rows);
+        assert(calls == (max_depth == 0 ? 0 : rows.size()));
+    }}
+    return 0;
+}}
+"#
+    )
+    .unwrap();
+
+    let status = Command::new("clang++")
+        .arg("--std=c++17")
+        .arg("-pthread")
         .arg("-o")
         .arg(dir.path().join("test"))
         .arg("-I")